@@ -81,7 +81,7 @@ architecture Behavioral of top is
 	signal s_ram_din : std_logic_vector(7 downto 0);
 	signal s_ram_dout : std_logic_vector(7 downto 0);
 	signal s_ram_wait : std_logic;
-	signal s_ram_addr : std_logic_vector(16 downto 0);
+	signal s_ram_addr : std_logic_vector(17 downto 0);
 
 	-- Audio
 	signal s_audio : std_logic;
@@ -176,7 +176,7 @@ begin
 	);
 
 
-	s_sri_addr <= "0000000000000" & s_ram_addr;
+	s_sri_addr <= "000000000000" & s_ram_addr;
 
 	trs80 : entity work.Trs80Model1Core
 	generic map
@@ -212,6 +212,7 @@ begin
 		o_audio => s_audio,
 		o_uart_tx => o_uart_tx,
 		i_uart_rx => i_uart_rx,
+		o_uart_rts_n => open,				-- Mimas V2's USB serial bridge has no RTS line
 		o_sd_mosi => o_sd_mosi,
 		i_sd_miso => i_sd_miso,
 		o_sd_ss_n => o_sd_ss_n,
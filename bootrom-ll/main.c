@@ -1,5 +1,19 @@
 #include <libSysCon.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cycle counter (perf counter 0, see SysConPerfCounters.vhd).  Write to
+// latch, read LSB first
+__sfr __at(0xB0) CycleCounterPort0;
+__sfr __at(0xB1) CycleCounterPort1;
+__sfr __at(0xB2) CycleCounterPort2;
+__sfr __at(0xB3) CycleCounterPort3;
+#define CYCLES_PER_US   80
+
+// SPI clock rate (in Mhz) the SD controller switches to after init
+__sfr __at(0x02) SdClockPort;
 
 char buf[128];
 
@@ -8,9 +22,15 @@ uint8_t dbuf[512];
 uint32_t block_number = 0;
 uint8_t start_fill_byte = 0;
 
+// Benchmark config (set with the 'c' command)
+uint32_t bench_start = 0;
+uint32_t bench_range = 2048;
+uint16_t bench_count = 256;
+bool bench_allow_write = false;
+
 void show_sd_status()
 {
-    sprintf(buf, "status: %x\n", (int)SdStatusPort);
+    sprintf(buf, "status: %x spi clock: %iMhz\n", (int)SdStatusPort, (int)SdClockPort);
     uart_write_sz(buf);
 }
 
@@ -26,6 +46,248 @@ void set_start_fill_byte(uint8_t val)
     uart_write_sz(buf);
 }
 
+// Read the free running cycle counter
+uint32_t read_cycles()
+{
+    CycleCounterPort0 = 0;
+    return CycleCounterPort0 | 
+        ((uint32_t)CycleCounterPort1 << 8) | 
+        ((uint32_t)CycleCounterPort2 << 16) | 
+        ((uint32_t)CycleCounterPort3 << 24);
+}
+
+// Latency histogram buckets are log-linear: 4 buckets per power of two
+// (in microseconds), so percentiles are accurate to within 25%
+#define HISTOGRAM_BUCKETS   92
+#define MAX_LATENCY_US      0xFFFFFF
+
+typedef struct
+{
+    uint16_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint16_t histogram[HISTOGRAM_BUCKETS];
+} STATS;
+
+STATS read_stats;
+STATS write_stats;
+
+uint8_t bucket_from_us(uint32_t us)
+{
+    if (us < 4)
+        return (uint8_t)us;
+
+    uint8_t msb = 2;
+    while ((us >> (msb + 1)) != 0)
+        msb++;
+
+    return (msb - 1) * 4 + (uint8_t)((us >> (msb - 2)) & 3);
+}
+
+uint32_t bucket_lower_bound(uint8_t bucket)
+{
+    if (bucket < 4)
+        return bucket;
+    return (uint32_t)(4 + (bucket & 3)) << (bucket / 4 - 1);
+}
+
+void stats_reset(STATS* p)
+{
+    memset(p, 0, sizeof(STATS));
+    p->min = 0xFFFFFFFF;
+}
+
+void stats_add(STATS* p, uint32_t cycles)
+{
+    uint32_t us = cycles / CYCLES_PER_US;
+    if (us > MAX_LATENCY_US)
+        us = MAX_LATENCY_US;
+
+    p->count++;
+    p->total += us;
+    if (us < p->min)
+        p->min = us;
+    if (us > p->max)
+        p->max = us;
+    p->histogram[bucket_from_us(us)]++;
+}
+
+// Upper bound of the bucket containing the p99 sample
+uint32_t stats_p99(STATS* p)
+{
+    uint16_t threshold = p->count - p->count / 100;
+    uint16_t seen = 0;
+    for (uint8_t i=0; i<HISTOGRAM_BUCKETS; i++)
+    {
+        seen += p->histogram[i];
+        if (seen >= threshold)
+            return bucket_lower_bound(i + 1) - 1;
+    }
+    return p->max;
+}
+
+void stats_report(const char* pszName, STATS* p)
+{
+    if (p->count == 0)
+        return;
+
+    // MB/s * 100 = count * 512 * 100 / 1048576 / seconds
+    uint32_t mbps100 = p->total ? (uint32_t)p->count * 48828 / p->total : 0;
+
+    sprintf(buf, "%s: %u blocks %lu.%02lu MB/s\n", pszName, p->count, 
+        (unsigned long)(mbps100 / 100), (unsigned long)(mbps100 % 100));
+    uart_write_sz(buf);
+    sprintf(buf, "  latency us: min %lu avg %lu p99 %lu max %lu\n",
+        (unsigned long)p->min, (unsigned long)(p->total / p->count), 
+        (unsigned long)stats_p99(p), (unsigned long)p->max);
+    uart_write_sz(buf);
+
+    for (uint8_t i=0; i<HISTOGRAM_BUCKETS; i++)
+    {
+        if (p->histogram[i] == 0)
+            continue;
+        sprintf(buf, "  %8lu-%-8lu %u\n", 
+            (unsigned long)bucket_lower_bound(i), (unsigned long)bucket_lower_bound(i + 1) - 1,
+            p->histogram[i]);
+        uart_write_sz(buf);
+    }
+}
+
+// xorshift32 for random block numbers
+uint32_t rand_state = 0x12345678;
+uint32_t rand32()
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+// Benchmark modes
+#define BENCH_SEQ_READ      0
+#define BENCH_RANDOM_READ   1
+#define BENCH_SEQ_WRITE     2
+#define BENCH_RANDOM_WRITE  3
+#define BENCH_MIXED         4   // Random, 75% reads 25% writes
+
+const char* bench_names[] = {
+    "sequential read",
+    "random read",
+    "sequential write",
+    "random write",
+    "mixed 75/25",
+};
+
+void run_bench(uint8_t mode)
+{
+    stats_reset(&read_stats);
+    stats_reset(&write_stats);
+
+    for (int i=0; i<512; i++)
+        dbuf[i] = (uint8_t)i;
+
+    uint32_t block = bench_start;
+    for (uint16_t i=0; i<bench_count; i++)
+    {
+        bool write = mode == BENCH_SEQ_WRITE || mode == BENCH_RANDOM_WRITE;
+        if (mode == BENCH_MIXED)
+            write = (rand32() & 3) == 0;
+
+        if (mode == BENCH_SEQ_READ || mode == BENCH_SEQ_WRITE)
+        {
+            block = bench_start + i % bench_range;
+        }
+        else
+        {
+            block = bench_start + rand32() % bench_range;
+        }
+
+        if (write)
+        {
+            SdCommandPort = SD_COMMAND_NOP;
+            uint32_t start = read_cycles();
+            sd_write(block, dbuf);
+            stats_add(&write_stats, read_cycles() - start);
+        }
+        else
+        {
+            uint32_t start = read_cycles();
+            sd_read(block, dbuf);
+            stats_add(&read_stats, read_cycles() - start);
+        }
+    }
+
+    sprintf(buf, "\n%s (lba %lx + %lx)\n", bench_names[mode], 
+        (unsigned long)bench_start, (unsigned long)bench_range);
+    uart_write_sz(buf);
+    stats_report("read", &read_stats);
+    stats_report("write", &write_stats);
+}
+
+void run_benchmarks()
+{
+    run_bench(BENCH_SEQ_READ);
+    run_bench(BENCH_RANDOM_READ);
+    if (bench_allow_write)
+    {
+        run_bench(BENCH_SEQ_WRITE);
+        run_bench(BENCH_RANDOM_WRITE);
+        run_bench(BENCH_MIXED);
+    }
+    else
+    {
+        uart_write_sz("(write tests skipped - enable with 'c <start> <range> <count> w')\n");
+    }
+}
+
+void show_bench_config()
+{
+    sprintf(buf, "bench: lba %lx range %lx count %u%s\n",
+        (unsigned long)bench_start, (unsigned long)bench_range, bench_count,
+        bench_allow_write ? " (writes enabled)" : "");
+    uart_write_sz(buf);
+}
+
+// Configure the benchmark: "c <start lba hex> <range hex> <count> [w]"
+// The write tests overwrite the range so must be explicitly enabled.
+void set_bench_config(uint8_t recv)
+{
+    // Collect the rest of the line
+    char line[64];
+    uint8_t len = 0;
+    uint8_t i = 1;
+    while (true)
+    {
+        while (i < recv && buf[i] != '\n' && buf[i] != '\r')
+        {
+            if (len < sizeof(line) - 1)
+                line[len++] = buf[i];
+            i++;
+        }
+        if (i < recv)
+            break;
+        recv = uart_read(buf, sizeof(buf));
+        i = 0;
+    }
+    line[len] = '\0';
+
+    char* p = line;
+    bench_start = strtoul(p, &p, 16);
+    bench_range = strtoul(p, &p, 16);
+    bench_count = (uint16_t)strtoul(p, &p, 10);
+    while (*p == ' ')
+        p++;
+    bench_allow_write = *p == 'w';
+
+    if (bench_range == 0)
+        bench_range = 1;
+    if (bench_count == 0)
+        bench_count = 1;
+
+    show_bench_config();
+}
+
 // Main Entry Point
 void main(void) 
 {
@@ -104,6 +366,17 @@ void main(void)
                 set_start_fill_byte(--start_fill_byte);
                 continue;
             }
+            if (buf[0] == 'c')
+            {
+                set_bench_config(recv);
+                continue;
+            }
+            if (buf[0] == 'b')
+            {
+                show_bench_config();
+                run_benchmarks();
+                continue;
+            }
         }
     }
 }
@@ -0,0 +1,2 @@
+// The CRC-32 kernel is shared with the syscon, build the same source
+#include "../syscon/crc32_update.c"
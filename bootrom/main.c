@@ -1,13 +1,66 @@
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
 #include <libSysCon.h>
 #include <ff.h>
 #include <diskio.h>
+#include "../syscon/loadstamp.h"
 
 char g_szTemp[128];
 FATFS g_fs;
 
 void thunkStart();
 
+// crc32_update.c (shared with the syscon)
+uint32_t crc32_update(uint32_t crc, const void* p, uint16_t length);
+
+// Check if the image described by a load stamp is still resident and
+// matches the file on the SD card.  Leaves the page bank enabled.
+bool is_resident(uint8_t slot, uint8_t firstBank, FILINFO* pfi)
+{
+    // Read the stamp
+    LOADSTAMP stamp;
+    ApmPageBank = BANK_STAMPS;
+    memcpy(&stamp, banked_page + slot * sizeof(LOADSTAMP), sizeof(LOADSTAMP));
+
+    // Check it matches the file
+    if (stamp.signature != STAMP_SIGNATURE || 
+        stamp.firstBank != firstBank ||
+        stamp.size != pfi->fsize || 
+        stamp.fdate != pfi->fdate || 
+        stamp.ftime != pfi->ftime)
+        return false;
+
+    // Check the resident copy hasn't been damaged
+    uint32_t crc = 0;
+    uint32_t remaining = stamp.size;
+    ApmPageBank = firstBank;
+    while (remaining)
+    {
+        uint16_t chunk = remaining > sizeof(banked_page) ? sizeof(banked_page) : remaining;
+        crc = crc32_update(crc, banked_page, chunk);
+        remaining -= chunk;
+        ApmPageBank++;
+    }
+    return crc == stamp.crc;
+}
+
+// Write a load stamp
+void write_stamp(uint8_t slot, uint8_t firstBank, FILINFO* pfi, uint32_t crc)
+{
+    LOADSTAMP stamp;
+    memset(&stamp, 0, sizeof(stamp));
+    stamp.signature = STAMP_SIGNATURE;
+    stamp.size = pfi->fsize;
+    stamp.fdate = pfi->fdate;
+    stamp.ftime = pfi->ftime;
+    stamp.crc = crc;
+    stamp.firstBank = firstBank;
+
+    ApmPageBank = BANK_STAMPS;
+    memcpy(banked_page + slot * sizeof(LOADSTAMP), &stamp, sizeof(LOADSTAMP));
+}
+
 // Main Entry Point
 void main(void) 
 {
@@ -25,36 +78,56 @@ void main(void)
     }
     uart_write_sz(" OK\n");
 
-    // Open big80.sys
-    FIL f;
-    uart_write_sz("Opening big80.sys...");
-    r = f_open(&f, "0:/big80.sys", FA_OPEN_EXISTING | FA_READ);
-    if (r != 0)
-    {
-        sprintf(g_szTemp, " FAILED (%i)\n", r);
-        uart_write_sz(g_szTemp);
-        return;
-    }
-    uart_write_sz(" OK\n");
-
     // Map page bank to the syscon memory (starting at bank 64 after trs80 64k address space)
     ApmEnable = APM_ENABLE_BOOTROM | APM_ENABLE_PAGEBANK;
-    ApmPageBank = 64;
-    uint32_t totalBytes = 0;
-    while (1)
+
+    // Already loaded? (warm reset)
+    FILINFO fi;
+    FRESULT rStat = f_stat("0:/big80.sys", &fi);
+    if (rStat == 0 && is_resident(STAMP_SYSCON, 64, &fi))
     {
-        UINT bytes_read = 0;
-        FRESULT err = f_read(&f, (BYTE*)banked_page, sizeof(banked_page), &bytes_read);
-        totalBytes += bytes_read;
-        ApmPageBank++;
-        if (bytes_read != sizeof(banked_page))
-            break;
+        ApmEnable = APM_ENABLE_BOOTROM;
+        uart_write_sz("big80.sys already resident.\n");
     }
-    ApmEnable = APM_ENABLE_BOOTROM;
-    f_close(&f);
+    else
+    {
+        // Open big80.sys
+        FIL f;
+        uart_write_sz("Opening big80.sys...");
+        r = f_open(&f, "0:/big80.sys", FA_OPEN_EXISTING | FA_READ);
+        if (r != 0)
+        {
+            ApmEnable = APM_ENABLE_BOOTROM;
+            sprintf(g_szTemp, " FAILED (%i)\n", r);
+            uart_write_sz(g_szTemp);
+            return;
+        }
+        uart_write_sz(" OK\n");
+
+        // Load it
+        ApmPageBank = 64;
+        uint32_t totalBytes = 0;
+        uint32_t crc = 0;
+        while (1)
+        {
+            UINT bytes_read = 0;
+            FRESULT err = f_read(&f, (BYTE*)banked_page, sizeof(banked_page), &bytes_read);
+            crc = crc32_update(crc, banked_page, bytes_read);
+            totalBytes += bytes_read;
+            ApmPageBank++;
+            if (bytes_read != sizeof(banked_page))
+                break;
+        }
+        f_close(&f);
 
-    sprintf(g_szTemp, "big-80.sys loaded (%lu bytes).\n", totalBytes);
-    uart_write_sz(g_szTemp);
+        // Stamp it (only if the directory info was available)
+        if (rStat == 0 && totalBytes == fi.fsize)
+            write_stamp(STAMP_SYSCON, 64, &fi, crc);
+        ApmEnable = APM_ENABLE_BOOTROM;
+
+        sprintf(g_szTemp, "big-80.sys loaded (%lu bytes).\n", totalBytes);
+        uart_write_sz(g_szTemp);
+    }
 
     // Jump to big80.sys
     uart_write_sz("Jumping to big80.sys...\n");
@@ -0,0 +1,102 @@
+--------------------------------------------------------------------------
+--
+-- SysConPerfCounters
+--
+-- Bank of free running 32-bit event counters for performance
+-- measurement.  Each counter increments on every clock cycle its event
+-- input is asserted (so level inputs count cycles and single cycle pulses
+-- count events).  Counters wrap and are never cleared except by reset -
+-- the syscon reads them periodically and works with the differences.
+--
+-- Ports (relative to base port):
+--
+--   0 - write: latch all counters (so they can be read consistently)
+--   0-3 - read: selected latched counter, LSB first
+--   4 - read/write: counter select
+--
+-- Copyright (C) 2019 Topten Software.  All Rights Reserved.
+--
+--------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.ALL;
+use ieee.numeric_std.ALL;
+
+entity SysConPerfCounters is
+generic
+(
+	p_counter_count : integer := 8
+);
+port
+(
+	-- Control
+	i_clock : in std_logic;                         -- Clock
+	i_reset : in std_logic;                         -- Reset (synchronous, active high)
+
+	-- CPU interface
+	i_cpu_port_number : in std_logic_vector(2 downto 0);
+	i_cpu_port_wr_rising_edge : in std_logic;
+	o_cpu_din : out std_logic_vector(7 downto 0);
+	i_cpu_dout : in std_logic_vector(7 downto 0);
+
+	-- Events
+	i_events : in std_logic_vector(p_counter_count-1 downto 0)
+);
+end SysConPerfCounters;
+
+architecture behavior of SysConPerfCounters is
+	type counter_array is array(0 to p_counter_count-1) of unsigned(31 downto 0);
+	signal s_counters : counter_array;
+	signal s_latched : counter_array;
+	signal s_select : std_logic_vector(7 downto 0);
+	signal s_selected : unsigned(31 downto 0);
+begin
+
+	process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_counters <= (others => (others => '0'));
+				s_latched <= (others => (others => '0'));
+				s_select <= (others => '0');
+			else
+
+				-- Count events
+				for i in 0 to p_counter_count-1 loop
+					if i_events(i) = '1' then
+						s_counters(i) <= s_counters(i) + 1;
+					end if;
+				end loop;
+
+				-- Port writes
+				if i_cpu_port_wr_rising_edge = '1' then
+					if i_cpu_port_number = "000" then
+						s_latched <= s_counters;
+					elsif i_cpu_port_number = "100" then
+						s_select <= i_cpu_dout;
+					end if;
+				end if;
+
+			end if;
+		end if;
+	end process;
+
+	-- Select counter (out of range reads as zero)
+	process(s_select, s_latched)
+	begin
+		s_selected <= (others => '0');
+		for i in 0 to p_counter_count-1 loop
+			if unsigned(s_select) = i then
+				s_selected <= s_latched(i);
+			end if;
+		end loop;
+	end process;
+
+	o_cpu_din <=
+		s_select when i_cpu_port_number(2) = '1' else
+		std_logic_vector(s_selected(7 downto 0)) when i_cpu_port_number(1 downto 0) = "00" else
+		std_logic_vector(s_selected(15 downto 8)) when i_cpu_port_number(1 downto 0) = "01" else
+		std_logic_vector(s_selected(23 downto 16)) when i_cpu_port_number(1 downto 0) = "10" else
+		std_logic_vector(s_selected(31 downto 24));
+
+end;
@@ -0,0 +1,204 @@
+--------------------------------------------------------------------------
+--
+-- SysConSerialRxFifo
+--
+-- Deep receive FIFO for the syscon serial port.  Has its own UART
+-- receiver (listening to the same rx line as SysConSerialPort) that
+-- feeds a block RAM FIFO so bytes aren't lost while the syscon firmware
+-- is busy (eg: waiting on SD card writes).
+--
+-- Also generates an RTS flow control signal with hysteresis and counts
+-- overrun and framing errors.
+--
+-- Ports (relative to base port):
+--
+--   0 - read: next byte from fifo (pops on read)
+--   1 - read: status (see below)
+--       write: bit 0 = enable, bit 1 = clear error counters
+--   2 - read: overrun count (saturates at 255)
+--   3 - read: framing error count (saturates at 255)
+--
+-- Status bits:
+--
+--   0 - data available
+--   1 - fifo full
+--   2 - throttled (RTS de-asserted)
+--   7 - enabled
+--
+-- Copyright (C) 2019 Topten Software.  All Rights Reserved.
+--
+--------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.ALL;
+use ieee.numeric_std.ALL;
+
+entity SysConSerialRxFifo is
+generic
+(
+	p_clock_hz : integer := 80_000_000;				-- Frequency of the clock
+	p_addr_width : integer := 11					-- Size of the fifo as power of 2 (2K)
+);
+port
+(
+    -- Control
+	i_clock : in std_logic;                         -- Clock
+	i_reset : in std_logic;                         -- Reset (synchronous, active high)
+
+	-- CPU interface
+	i_cpu_port_number : in std_logic_vector(1 downto 0);
+	i_cpu_port_wr_rising_edge : in std_logic;
+	i_cpu_port_rd_falling_edge : in std_logic;
+	o_cpu_din : out std_logic_vector(7 downto 0);
+	i_cpu_dout : in std_logic_vector(7 downto 0);
+
+	-- State
+	o_enabled : out std_logic;						-- Asserted when the fifo is enabled
+	o_irq : out std_logic;							-- Asserted when data available
+	o_overrun : out std_logic;						-- Pulses when a byte is dropped
+
+	-- UART
+	i_uart_rx : in std_logic;						-- UART receive line
+	o_uart_rts_n : out std_logic					-- Ready to send (active low)
+);
+end SysConSerialRxFifo;
+
+architecture behavior of SysConSerialRxFifo is
+
+	constant c_size : integer := 2 ** p_addr_width;
+	constant c_rts_off : integer := c_size * 3 / 4;			-- De-assert RTS when this full
+	constant c_rts_on : integer := c_size / 4;				-- Re-assert RTS when drained to this
+
+	type mem_type is array(0 to c_size-1) of std_logic_vector(7 downto 0);
+	shared variable ram : mem_type;
+
+	signal s_uart_data : std_logic_vector(7 downto 0);
+	signal s_uart_data_available : std_logic;
+	signal s_uart_error : std_logic;
+	signal s_uart_error_prev : std_logic;
+
+	signal s_enabled : std_logic;
+	signal s_write_ptr : unsigned(p_addr_width-1 downto 0);
+	signal s_read_ptr : unsigned(p_addr_width-1 downto 0);
+	signal s_count : integer range 0 to c_size;
+	signal s_head : std_logic_vector(7 downto 0);
+	signal s_full : std_logic;
+	signal s_empty : std_logic;
+	signal s_push : std_logic;
+	signal s_pop : std_logic;
+	signal s_throttled : std_logic;
+	signal s_overrun_count : unsigned(7 downto 0);
+	signal s_error_count : unsigned(7 downto 0);
+
+begin
+
+	-- UART receiver
+	uart_rx : entity work.UartRx
+	generic map
+	(
+	    p_clock_hz => p_clock_hz
+	)
+	port map
+	(
+		i_clock => i_clock,
+		i_reset => i_reset,
+		i_uart_rx => i_uart_rx,
+		o_data => s_uart_data,
+		o_data_available => s_uart_data_available,
+		o_busy => open,
+		o_error => s_uart_error
+	);
+
+	s_full <= '1' when s_count = c_size else '0';
+	s_empty <= '1' when s_count = 0 else '0';
+	s_push <= s_uart_data_available and s_enabled and not s_full;
+	s_pop <= '1' when i_cpu_port_rd_falling_edge = '1' and i_cpu_port_number = "00" and s_empty = '0' else '0';
+
+	o_enabled <= s_enabled;
+	o_irq <= not s_empty;
+	o_overrun <= s_uart_data_available and s_enabled and s_full;
+	o_uart_rts_n <= s_throttled;
+
+	-- Fifo memory
+	fifo_ram : process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if s_push = '1' then
+				ram(to_integer(s_write_ptr)) := s_uart_data;
+			end if;
+			s_head <= ram(to_integer(s_read_ptr));
+		end if;
+	end process;
+
+	-- Fifo pointers, flow control and error counters
+	fifo_ctrl : process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_enabled <= '0';
+				s_write_ptr <= (others => '0');
+				s_read_ptr <= (others => '0');
+				s_count <= 0;
+				s_throttled <= '0';
+				s_overrun_count <= (others => '0');
+				s_error_count <= (others => '0');
+				s_uart_error_prev <= '0';
+			else
+
+				-- Update pointers
+				if s_push = '1' then
+					s_write_ptr <= s_write_ptr + 1;
+				end if;
+				if s_pop = '1' then
+					s_read_ptr <= s_read_ptr + 1;
+				end if;
+				if s_push = '1' and s_pop = '0' then
+					s_count <= s_count + 1;
+				elsif s_push = '0' and s_pop = '1' then
+					s_count <= s_count - 1;
+				end if;
+
+				-- Flow control (with hysteresis)
+				if s_count >= c_rts_off then
+					s_throttled <= '1';
+				elsif s_count <= c_rts_on then
+					s_throttled <= '0';
+				end if;
+
+				-- Count overruns
+				if s_uart_data_available = '1' and s_enabled = '1' and s_full = '1' and s_overrun_count /= x"FF" then
+					s_overrun_count <= s_overrun_count + 1;
+				end if;
+
+				-- Count framing errors
+				s_uart_error_prev <= s_uart_error;
+				if s_uart_error = '1' and s_uart_error_prev = '0' and s_error_count /= x"FF" then
+					s_error_count <= s_error_count + 1;
+				end if;
+
+				-- Control port write
+				if i_cpu_port_wr_rising_edge = '1' and i_cpu_port_number = "01" then
+					s_enabled <= i_cpu_dout(0);
+					if i_cpu_dout(1) = '1' then
+						s_overrun_count <= (others => '0');
+						s_error_count <= (others => '0');
+					end if;
+					if i_cpu_dout(0) = '0' then
+						s_write_ptr <= (others => '0');
+						s_read_ptr <= (others => '0');
+						s_count <= 0;
+					end if;
+				end if;
+
+			end if;
+		end if;
+	end process;
+
+	-- Port reads
+	o_cpu_din <=
+		s_head when i_cpu_port_number = "00" else
+		s_enabled & "0000" & s_throttled & s_full & not s_empty when i_cpu_port_number = "01" else
+		std_logic_vector(s_overrun_count) when i_cpu_port_number = "10" else
+		std_logic_vector(s_error_count);
+
+end;
@@ -30,6 +30,7 @@ port
 	-- Input
 	i_motor : in std_logic;							-- Motor control bit
 	i_audio : in std_logic;							-- The audio signal to be monitored
+	i_data_cycle : in std_logic;					-- Byte written directly to the recorder (fast save)
 
 	-- Output
 	o_start : out std_logic;						-- Asserts for one cycle when cassette operation should start
@@ -76,8 +77,9 @@ begin
 						s_ticks_since_motor_on <= s_ticks_since_motor_on + 1;
 					end if;
 
-					-- Watch for a positive edge on the audio
-					if s_audio_prev = '0' and i_audio = '1' then
+					-- Watch for a positive edge on the audio (or a byte
+					-- written directly, which also means it's a record)
+					if (s_audio_prev = '0' and i_audio = '1') or i_data_cycle = '1' then
 						s_any_edges <= '1';
 					end if;
 	
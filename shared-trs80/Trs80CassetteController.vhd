@@ -37,6 +37,7 @@ port
 	o_status_playing : out std_logic;
 	o_status_recording : out std_logic;
 	o_status_need_block_number : out std_logic;
+	o_status_stalled : out std_logic;
 
 	-- Raised for one clken_cpu cycle anytime any of the above status bits change
 	o_irq : out std_logic;
@@ -45,6 +46,16 @@ port
 	i_block_number : in std_logic_vector(31 downto 0);
 	i_block_number_load : in std_logic;
 
+	-- Direct block data (playback from a source other than the SD card)
+	i_direct_load : in std_logic;					-- Assert instead of i_block_number_load when the
+													-- next block will be supplied via i_direct_data
+	i_direct_data : in std_logic_vector(7 downto 0);
+	i_direct_data_cycle : in std_logic;				-- Assert for one cycle for each byte (512 per block)
+
+	-- Fast save (record bytes supplied directly instead of from the audio)
+	i_fast_data_cycle : in std_logic;				-- Assert for one cycle for each recorded byte (uses i_direct_data)
+	o_record_full : out std_logic;					-- Record buffer full, hold off further fast save bytes
+
 	-- SD Inteface
 	o_sd_op_wr : out std_logic;
 	o_sd_op_cmd : out std_logic_vector(1 downto 0);
@@ -58,8 +69,11 @@ port
 
 	-- Audio
 	o_audio : out std_logic_vector(1 downto 0);		-- to Trs80
-	i_audio : in std_logic							-- from Trs80
+	i_audio : in std_logic;							-- from Trs80
 
+	-- Underrun
+	o_stall : out std_logic;						-- Asserted while playback is waiting for a late block
+	o_underrun : out std_logic						-- Pulses when a stall starts
 );
 end Trs80CassetteController;
  
@@ -76,6 +90,11 @@ architecture behavior of Trs80CassetteController is
 	signal s_mode_changed : std_logic;		-- either playing or recording changed
 
 	signal s_prev_need_block_number : std_logic;
+	signal s_stall : std_logic;
+	signal s_prev_stall : std_logic;
+	signal s_streamer_data_cycle : std_logic;
+	signal s_streamer_data : std_logic_vector(7 downto 0);
+	signal s_fast_data_cycle : std_logic;
 
 	type states is
 	(
@@ -95,6 +114,8 @@ begin
 	o_status_recording <= s_recording;
 	s_need_block_number <= '1' when s_state = state_waiting_block_number else '0';
 	o_status_need_block_number <= s_need_block_number;
+	o_status_stalled <= s_stall;
+	o_stall <= s_stall;
 
 
 	-- Generate IRQ whenever any of the output status bits change
@@ -103,14 +124,18 @@ begin
 		if rising_edge(i_clock) then
 			if i_reset = '1' then
 				s_prev_need_block_number <= '0';
+				s_prev_stall <= '0';
 				o_irq <= '0';
 			elsif i_clken_cpu = '1' then
 
-				-- Pulse irq on rising edge of need block number, or when 
-				-- the play/record status bits change
+				-- Pulse irq on rising edge of need block number or stalled,
+				-- or when the play/record status bits change
 				o_irq <= '0';
 				s_prev_need_block_number <= s_need_block_number;
-				if (s_prev_need_block_number = '0' and s_need_block_number = '1') or s_mode_changed = '1' then
+				s_prev_stall <= s_stall;
+				if (s_prev_need_block_number = '0' and s_need_block_number = '1') or 
+					(s_prev_stall = '0' and s_stall = '1') or 
+					s_mode_changed = '1' then
 					o_irq <= '1';
 				end if;
 
@@ -186,13 +211,25 @@ begin
 		o_audio => o_audio,
 		i_audio => i_audio,
 		o_block_available => s_streamer_block_available,
+		i_fast_data_cycle => s_fast_data_cycle,
+		i_fast_data => i_direct_data,
+		o_record_full => o_record_full,
 		i_stop_recording => s_stop_recording,
 		o_recording_finished => s_recording_finished,	
-		i_data_cycle => i_sd_dcycle,
-		i_data => i_sd_data,
+		o_stall => s_stall,
+		o_underrun => o_underrun,
+		i_data_cycle => s_streamer_data_cycle,
+		i_data => s_streamer_data,
 		o_data => o_sd_data
 	);
 
+	-- Playback data comes from either the SD card or the direct data port
+	s_streamer_data_cycle <= i_sd_dcycle or (i_direct_data_cycle and not s_recording);
+	s_streamer_data <= i_direct_data when i_direct_data_cycle = '1' else i_sd_data;
+
+	-- Fast save data is only accepted while recording
+	s_fast_data_cycle <= i_fast_data_cycle and s_recording;
+
 	-- Hold the streamer in reset state when not playing or recording
 	s_streamer_reset <= '1' when i_reset = '1' or s_playing_or_recording = '0' else '0';
 
@@ -225,6 +262,8 @@ begin
 							if i_block_number_load = '1' then
 								s_state <= state_waiting_sd_not_busy;
 								debug(5) <= '1';
+							elsif i_direct_load = '1' and s_recording = '0' then
+								s_state <= state_idle;
 							end if;
 
 						when state_waiting_sd_not_busy =>
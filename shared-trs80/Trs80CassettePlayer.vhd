@@ -172,6 +172,8 @@ begin
 
 		i_audio => i_audio,
 		o_block_available => s_sd_block_available,
+		i_fast_data_cycle => '0',
+		i_fast_data => x"00",
 		i_stop_recording => s_stop_recording,
 		o_recording_finished => s_recording_finished,	
 
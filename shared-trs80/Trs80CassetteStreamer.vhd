@@ -14,6 +14,11 @@
 -- This component constantly produces an audio signal.  When not in use,
 -- assert i_reset to go silent.
 --
+-- In record mode bytes can also be supplied directly on i_fast_data
+-- (bypassing the parser) for fast save.  o_record_full asserts when the
+-- next direct byte would overwrite data that hasn't been written to the
+-- SD card yet and the client should hold off until it clears.
+--
 -- Copyright (C) 2019 Topten Software.  All Rights Reserved.
 --
 --------------------------------------------------------------------------
@@ -46,6 +51,11 @@ port
 	i_audio : in std_logic;							-- input audio stream
 	o_block_available : out std_logic;				-- Asserts for one main clock cycle when next 512 bytes are available
 
+	-- Fast save record
+	i_fast_data_cycle : in std_logic;				-- Assert for one main clock cycle to record the byte on i_fast_data
+	i_fast_data : in std_logic_vector(7 downto 0);	-- Byte to record
+	o_record_full : out std_logic;					-- Record buffer full, don't supply more fast data
+
 	-- Buffering
 	i_data_cycle : in std_logic;					-- Play: assert for one main clock cycle when 
 													--       input data on o_data is valid
@@ -56,7 +66,12 @@ port
 	o_data : out std_logic_vector(7 downto 0);		-- Record: Output data
 
 	i_stop_recording : in std_logic;				-- Assert for 1 cycle to stop the recorder and flush buffers
-	o_recording_finished : out std_logic			-- Asserts for 1 cycle when recording buffers have been flushed
+	o_recording_finished : out std_logic;			-- Asserts for 1 cycle when recording buffers have been flushed
+
+	-- Underrun
+	o_stall : out std_logic;						-- Asserted while playback is stalled waiting for the 
+													-- next block (the client should stop the clock enable)
+	o_underrun : out std_logic						-- Asserts for 1 cycle when a stall starts
 );
 end Trs80CassetteStreamer;
  
@@ -67,6 +82,9 @@ architecture behavior of Trs80CassetteStreamer is
 	signal s_render_byte : std_logic_vector(7 downto 0);
 	signal s_render_data_needed : std_logic;
 	signal s_renderer_reset : std_logic;
+	signal s_renderer_clken : std_logic;
+	signal s_stall : std_logic;
+	signal s_prev_stall : std_logic;
 
 	signal s_parser_byte : std_logic_vector(7 downto 0);
 	signal s_parser_data_available : std_logic;
@@ -135,7 +153,7 @@ begin
 	port map
 	(
 		i_clock => i_clock,
-		i_clken => i_clken,
+		i_clken => s_renderer_clken,
 		i_reset => s_renderer_reset,
 		i_data => s_render_byte,
 		o_data_needed => s_render_data_needed,
@@ -190,11 +208,20 @@ begin
 	s_ram_write_data <= 
 		x"00" when s_state = state_RecFlushZero else
 		i_data when s_record_mode = '0' else 
+		i_fast_data when i_fast_data_cycle = '1' else
 		s_parser_byte;
 	s_ram_write <= 
 		'1' when s_state = state_RecFlushZero else 
 		i_data_cycle when s_record_mode = '0' else 
-		(s_parser_data_available and i_clken);
+		(s_parser_data_available and i_clken) or i_fast_data_cycle;
+
+	-- The record buffer is full when the next write would wrap into 
+	-- the half buffer that's still being written to the SD card
+	o_record_full <= '1' when 
+		s_record_mode = '1' and 
+		s_ram_write_addr(p_buffer_size) /= s_ram_read_addr(p_buffer_size) and
+		s_ram_write_addr(p_buffer_size-1 downto 0) = c_low_addr_ones
+		else '0';
 
 	-- RAM read goes to both renderer and to output
 	s_render_byte <= s_ram_read_data;
@@ -202,6 +229,30 @@ begin
 
 	o_recording_finished <= '1' when s_state = state_RecFinished else '0';
 
+	-- Stall when the renderer is about to move into the half buffer that's 
+	-- still being filled.  The renderer is frozen (in the silent gap at the 
+	-- end of the last bit) until the block arrives so the audio stream is
+	-- never corrupted, just delayed.
+	s_stall <= '1' when 
+		s_state = state_PlayBuffering and 
+		s_render_data_needed = '1' and 
+		s_ram_read_addr(p_buffer_size-1 downto 0) = c_low_addr_ones
+		else '0';
+	s_renderer_clken <= i_clken and not s_stall;
+	o_stall <= s_stall;
+
+	stall_edge : process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_prev_stall <= '0';
+			else
+				s_prev_stall <= s_stall;
+			end if;
+		end if;
+	end process;
+	o_underrun <= s_stall and not s_prev_stall;
+
 	-- whenever the client sends us data, move to next write address
 	buffer_proc: process(i_clock)
 	begin
@@ -216,7 +267,7 @@ begin
 				o_block_needed <= '0';
 				o_block_available <= '0';
 
-				if i_clken = '1' then
+				if s_renderer_clken = '1' then
 
 					-- whenever the renderer wants more data, move to the next read address
 					if s_record_mode = '0' and s_render_data_needed = '1' then
@@ -230,6 +281,11 @@ begin
 
 				end if;
 
+				-- Fast save bytes arrive independently of the clock enable
+				if s_record_mode = '1' and i_fast_data_cycle = '1' then
+					s_ram_write_addr <= std_logic_vector(unsigned(s_ram_write_addr) + 1);
+				end if;
+
 				-- Stop recording?
 				if i_stop_recording = '1' then 
 					s_record_mode <= '0';
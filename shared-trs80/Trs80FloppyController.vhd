@@ -0,0 +1,527 @@
+--------------------------------------------------------------------------
+--
+-- Trs80FloppyController
+--
+-- Emulates the FD1771 floppy disk controller and drive select latch of
+-- the TRS-80 Model 1 Expansion Interface.
+--
+-- Type I commands (restore, seek, step) are handled entirely in hardware.
+-- Type II and III commands (read/write sector, read address, read/write
+-- track) are serviced by the syscon firmware which moves sector data in
+-- and out of a 1K buffer.  Since the syscon runs by hijacking the same
+-- CPU, the TRS-80 doesn't see any time pass while the request is being
+-- serviced.
+--
+-- TRS-80 memory map (0x37E0 -> 0x37EF):
+--
+--   0x37E0 -> 0x37E3 - read: interrupt latch (bit 7 = 40Hz clock, bit 6 = FDC),
+--                      write: drive select
+--   0x37EC - read: status, write: command
+--   0x37ED - track register
+--   0x37EE - sector register
+--   0x37EF - data register
+--
+-- If no drives are present the entire range reads as 0xFF so the
+-- Level II ROM doesn't try to boot from disk.
+--
+-- Like the Expansion Interface, a 40Hz clock sets bit 7 of the interrupt
+-- latch (cleared by reading the latch) and either latch bit interrupts
+-- the TRS-80 (o_cpu_int).  The disk operating systems use it for their 
+-- clocks and background tasks.  Level II never enables interrupts.
+--
+-- The drive motors run for 2 seconds after the last drive select, after
+-- which the syscon is asked to write back cached tracks.
+--
+-- SysCon ports (relative to base port):
+--
+--          Read                        Write
+--   0      command                     result status
+--   1      drive select latch          transfer count (low)
+--   2      track register              transfer count (high)
+--   3      sector register             control (see below)
+--   4      physical track              drive present (0..3) / write protect (4..7)
+--   5      service phase               reset buffer pointer
+--   6      buffer data                 buffer data
+--   7      data register               -
+--
+-- Service phases:
+--
+--   0 - idle
+--   1 - type II/III command waiting to be started (or completed)
+--   2 - write transfer finished, buffer ready to be read
+--
+--   bit 2 is set (with any of the above) once the motors have stopped
+--
+-- Control bits:
+--
+--   0 - start a transfer of "transfer count" bytes between the buffer and
+--       the TRS-80 (direction depends on the command)
+--   1 - complete the command with the result status and raise INTRQ
+--   2 - acknowledge motors stopped
+--
+-- Copyright (C) 2019 Topten Software.  All Rights Reserved.
+--
+--------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.ALL;
+use ieee.numeric_std.ALL;
+
+entity Trs80FloppyController is
+generic
+(
+	p_clock_hz : integer := 80_000_000;				-- Frequency of the clock
+	p_type1_delay_us : integer := 50;				-- How long type I commands stay busy
+	p_motor_ms : integer := 2000					-- How long the motors run after a drive select
+);
+port
+(
+    -- Control
+	i_clock : in std_logic;                         -- Clock
+	i_reset : in std_logic;                         -- Reset (synchronous, active high)
+
+	-- TRS-80 interface
+	i_cpu_addr : in std_logic_vector(3 downto 0);
+	i_cpu_mem_wr_rising_edge : in std_logic;
+	i_cpu_mem_rd_falling_edge : in std_logic;
+	o_cpu_din : out std_logic_vector(7 downto 0);
+	i_cpu_dout : in std_logic_vector(7 downto 0);
+
+	-- SysCon interface
+	i_syscon_port_number : in std_logic_vector(2 downto 0);
+	i_syscon_port_wr_rising_edge : in std_logic;
+	i_syscon_port_rd_falling_edge : in std_logic;
+	o_syscon_din : out std_logic_vector(7 downto 0);
+	o_syscon_irq : out std_logic;
+
+	-- Interrupt
+	o_cpu_int : out std_logic						-- TRS-80 interrupt request (clock or FDC)
+);
+end Trs80FloppyController;
+
+architecture behavior of Trs80FloppyController is
+
+	constant c_type1_delay : integer := p_clock_hz / 1_000_000 * p_type1_delay_us;
+	constant c_index_period : integer := p_clock_hz / 5;			-- 300 RPM
+	constant c_index_width : integer := p_clock_hz / 250;			-- 4ms
+	constant c_rtc_period : integer := p_clock_hz / 40;				-- 40Hz
+	constant c_motor_time : integer := p_clock_hz / 1000 * p_motor_ms;
+
+	type mem_type is array(0 to 1023) of std_logic_vector(7 downto 0);
+	shared variable ram : mem_type;
+
+	type track_array is array(0 to 3) of unsigned(7 downto 0);
+	signal s_phys_track : track_array;
+
+	signal s_drive_select : std_logic_vector(3 downto 0);
+	signal s_drive_present : std_logic_vector(3 downto 0);
+	signal s_write_protect : std_logic_vector(3 downto 0);
+	signal s_drive : integer range 0 to 3;
+	signal s_drive_ready : std_logic;
+	signal s_drive_wp : std_logic;
+	signal s_any_drives : std_logic;
+
+	signal s_command : std_logic_vector(7 downto 0);
+	signal s_track : std_logic_vector(7 downto 0);
+	signal s_sector : std_logic_vector(7 downto 0);
+	signal s_data : std_logic_vector(7 downto 0);
+	signal s_step_in : std_logic;
+	signal s_type1 : std_logic;
+	signal s_busy : std_logic;
+	signal s_drq : std_logic;
+	signal s_intrq : std_logic;
+	signal s_result : std_logic_vector(7 downto 0);
+	signal s_head_loaded : std_logic;
+	signal s_type1_delay : integer range 0 to c_type1_delay;
+	signal s_phase : std_logic_vector(1 downto 0);
+
+	signal s_xfer : std_logic;
+	signal s_xfer_write : std_logic;
+	signal s_xfer_count : unsigned(10 downto 0);
+	signal s_buf_ptr : unsigned(9 downto 0);
+	signal s_buf_dout : std_logic_vector(7 downto 0);
+	signal s_buf_write : std_logic;
+	signal s_buf_din : std_logic_vector(7 downto 0);
+
+	signal s_index_counter : integer range 0 to c_index_period - 1;
+	signal s_index : std_logic;
+
+	signal s_rtc_counter : integer range 0 to c_rtc_period - 1;
+	signal s_rtc_int : std_logic;
+	signal s_motor_timer : integer range 0 to c_motor_time;
+	signal s_motor_stopped : std_logic;
+
+	signal s_status : std_logic_vector(7 downto 0);
+	signal s_track0 : std_logic;
+
+	signal s_cpu_wr_status : std_logic;
+	signal s_cpu_wr_data : std_logic;
+	signal s_cpu_rd_status : std_logic;
+	signal s_cpu_rd_data : std_logic;
+	signal s_syscon_wr_buf : std_logic;
+	signal s_syscon_rd_buf : std_logic;
+
+begin
+
+	-- Work out the selected drive
+	s_drive <=
+		0 when s_drive_select(0) = '1' else
+		1 when s_drive_select(1) = '1' else
+		2 when s_drive_select(2) = '1' else
+		3;
+	s_drive_ready <= s_drive_present(s_drive) when s_drive_select /= "0000" else '0';
+	s_drive_wp <= s_write_protect(s_drive);
+	s_any_drives <= '1' when s_drive_present /= "0000" else '0';
+
+	-- Index pulse generator
+	index_gen : process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_index_counter <= 0;
+			elsif s_index_counter = c_index_period - 1 then
+				s_index_counter <= 0;
+			else
+				s_index_counter <= s_index_counter + 1;
+			end if;
+		end if;
+	end process;
+	s_index <= s_drive_ready when s_index_counter < c_index_width else '0';
+
+	-- 40Hz clock interrupt, cleared by reading the interrupt latch
+	rtc_gen : process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_rtc_counter <= 0;
+				s_rtc_int <= '0';
+			else
+				if s_rtc_counter = c_rtc_period - 1 then
+					s_rtc_counter <= 0;
+					s_rtc_int <= '1';
+				else
+					s_rtc_counter <= s_rtc_counter + 1;
+					if i_cpu_mem_rd_falling_edge = '1' and i_cpu_addr(3 downto 2) = "00" then
+						s_rtc_int <= '0';
+					end if;
+				end if;
+			end if;
+		end if;
+	end process;
+
+	o_cpu_int <= (s_rtc_int or s_intrq) and s_any_drives;
+
+	-- Status register
+	s_track0 <= s_drive_ready when s_phys_track(s_drive) = 0 else '0';
+	s_status <=
+		not s_drive_ready & s_drive_wp & s_head_loaded & "00" & s_track0 & s_index & s_busy when s_type1 = '1' else
+		not s_drive_ready & s_result(6 downto 2) & s_drq & s_busy;
+
+	-- Decode TRS-80 accesses
+	s_cpu_wr_status <= i_cpu_mem_wr_rising_edge when i_cpu_addr = x"C" else '0';
+	s_cpu_wr_data <= i_cpu_mem_wr_rising_edge when i_cpu_addr = x"F" else '0';
+	s_cpu_rd_status <= i_cpu_mem_rd_falling_edge when i_cpu_addr = x"C" else '0';
+	s_cpu_rd_data <= i_cpu_mem_rd_falling_edge when i_cpu_addr = x"F" else '0';
+
+	-- Decode SysCon buffer accesses
+	s_syscon_wr_buf <= i_syscon_port_wr_rising_edge when i_syscon_port_number = "110" else '0';
+	s_syscon_rd_buf <= i_syscon_port_rd_falling_edge when i_syscon_port_number = "110" else '0';
+
+	-- Sector buffer
+	s_buf_write <= s_syscon_wr_buf or (s_cpu_wr_data and s_xfer and s_xfer_write);
+	s_buf_din <= i_cpu_dout;
+
+	sector_buffer : process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if s_buf_write = '1' then
+				ram(to_integer(s_buf_ptr)) := s_buf_din;
+			end if;
+			s_buf_dout <= ram(to_integer(s_buf_ptr));
+		end if;
+	end process;
+
+	-- Controller
+	controller : process(i_clock)
+		variable v_track : unsigned(7 downto 0);
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_phys_track <= (others => (others => '0'));
+				s_drive_select <= (others => '0');
+				s_drive_present <= (others => '0');
+				s_write_protect <= (others => '0');
+				s_command <= (others => '0');
+				s_track <= (others => '0');
+				s_sector <= (others => '0');
+				s_data <= (others => '0');
+				s_step_in <= '1';
+				s_type1 <= '1';
+				s_busy <= '0';
+				s_drq <= '0';
+				s_intrq <= '0';
+				s_result <= (others => '0');
+				s_head_loaded <= '0';
+				s_type1_delay <= 0;
+				s_phase <= "00";
+				s_xfer <= '0';
+				s_xfer_write <= '0';
+				s_xfer_count <= (others => '0');
+				s_buf_ptr <= (others => '0');
+				s_motor_timer <= 0;
+				s_motor_stopped <= '0';
+			else
+
+				-- Motors stop a while after the last drive select
+				if s_motor_timer /= 0 then
+					if s_motor_timer = 1 then
+						s_motor_stopped <= '1';
+					end if;
+					s_motor_timer <= s_motor_timer - 1;
+				end if;
+
+				-- Finish type I commands after a short delay
+				if s_type1_delay /= 0 then
+					if s_type1_delay = 1 then
+						s_busy <= '0';
+						s_intrq <= '1';
+					end if;
+					s_type1_delay <= s_type1_delay - 1;
+				end if;
+
+				------------ TRS-80 Side ------------
+
+				-- Drive select latch
+				if i_cpu_mem_wr_rising_edge = '1' and i_cpu_addr(3 downto 2) = "00" then
+					s_drive_select <= i_cpu_dout(3 downto 0);
+					if i_cpu_dout(3 downto 0) /= "0000" then
+						s_motor_timer <= c_motor_time;
+					end if;
+				end if;
+
+				-- Track and sector register writes
+				if i_cpu_mem_wr_rising_edge = '1' and i_cpu_addr = x"D" and s_busy = '0' then
+					s_track <= i_cpu_dout;
+				end if;
+				if i_cpu_mem_wr_rising_edge = '1' and i_cpu_addr = x"E" and s_busy = '0' then
+					s_sector <= i_cpu_dout;
+				end if;
+
+				-- Data register write
+				if s_cpu_wr_data = '1' then
+					s_data <= i_cpu_dout;
+					if s_xfer = '1' and s_xfer_write = '1' then
+						s_buf_ptr <= s_buf_ptr + 1;
+						s_xfer_count <= s_xfer_count - 1;
+						if s_xfer_count = 1 then
+							-- Buffer full, hand it to syscon
+							s_xfer <= '0';
+							s_drq <= '0';
+							s_phase <= "10";
+						end if;
+					end if;
+				end if;
+
+				-- Data register read
+				if s_cpu_rd_data = '1' and s_xfer = '1' and s_xfer_write = '0' then
+					s_buf_ptr <= s_buf_ptr + 1;
+					s_xfer_count <= s_xfer_count - 1;
+					if s_xfer_count = 1 then
+						-- All data read, command complete
+						s_xfer <= '0';
+						s_drq <= '0';
+						s_busy <= '0';
+						s_intrq <= '1';
+					end if;
+				end if;
+
+				-- Status read clears INTRQ
+				if s_cpu_rd_status = '1' then
+					s_intrq <= '0';
+				end if;
+
+				-- Command write
+				if s_cpu_wr_status = '1' then
+
+					if i_cpu_dout(7 downto 4) = x"D" then
+
+						-- Force interrupt
+						s_busy <= '0';
+						s_drq <= '0';
+						s_xfer <= '0';
+						s_phase <= "00";
+						s_type1 <= '1';
+						s_type1_delay <= 0;
+						if i_cpu_dout(3 downto 0) /= "0000" then
+							s_intrq <= '1';
+						else
+							s_intrq <= '0';
+						end if;
+
+					elsif s_busy = '0' then
+
+						s_command <= i_cpu_dout;
+						s_intrq <= '0';
+						s_result <= (others => '0');
+
+						if i_cpu_dout(7) = '0' then
+
+							-- Type I
+							s_type1 <= '1';
+							s_busy <= '1';
+							s_head_loaded <= i_cpu_dout(3);
+							s_type1_delay <= c_type1_delay;
+
+							v_track := s_phys_track(s_drive);
+
+							case i_cpu_dout(6 downto 5) is
+								when "00" =>
+									if i_cpu_dout(4) = '0' then
+										-- Restore
+										v_track := (others => '0');
+										s_track <= (others => '0');
+									else
+										-- Seek
+										v_track := unsigned(s_data);
+										s_track <= s_data;
+										if unsigned(s_data) > s_phys_track(s_drive) then
+											s_step_in <= '1';
+										else
+											s_step_in <= '0';
+										end if;
+									end if;
+
+								when others =>
+									-- Step, step in, step out
+									if i_cpu_dout(6 downto 5) = "10" or (i_cpu_dout(6 downto 5) = "01" and s_step_in = '1') then
+										s_step_in <= '1';
+										if v_track /= x"FF" then
+											v_track := v_track + 1;
+										end if;
+										if i_cpu_dout(4) = '1' then
+											s_track <= std_logic_vector(unsigned(s_track) + 1);
+										end if;
+									else
+										s_step_in <= '0';
+										if v_track /= x"00" then
+											v_track := v_track - 1;
+										end if;
+										if i_cpu_dout(4) = '1' then
+											s_track <= std_logic_vector(unsigned(s_track) - 1);
+										end if;
+									end if;
+							end case;
+
+							s_phys_track(s_drive) <= v_track;
+
+						else
+
+							-- Type II and III
+							s_type1 <= '0';
+							s_head_loaded <= '1';
+
+							if s_drive_ready = '0' then
+								-- Drive not ready, finish immediately
+								s_intrq <= '1';
+							elsif i_cpu_dout(6 downto 5) = "01" and s_drive_wp = '1' then
+								-- Write sector to write protected disk
+								s_result <= x"40";
+								s_intrq <= '1';
+							elsif i_cpu_dout(7 downto 4) = x"F" and s_drive_wp = '1' then
+								-- Write track to write protected disk
+								s_result <= x"40";
+								s_intrq <= '1';
+							else
+								-- Ask syscon to service it
+								s_busy <= '1';
+								s_phase <= "01";
+							end if;
+
+						end if;
+
+					end if;
+				end if;
+
+				------------ SysCon Side ------------
+
+				if i_syscon_port_wr_rising_edge = '1' then
+					case i_syscon_port_number is
+						when "000" =>
+							s_result <= i_cpu_dout;
+
+						when "001" =>
+							s_xfer_count(7 downto 0) <= unsigned(i_cpu_dout);
+
+						when "010" =>
+							s_xfer_count(10 downto 8) <= unsigned(i_cpu_dout(2 downto 0));
+
+						when "011" =>
+							if i_cpu_dout(0) = '1' and s_xfer_count /= 0 then
+								-- Start transfer
+								s_phase <= "00";
+								s_xfer <= '1';
+								s_drq <= '1';
+								s_buf_ptr <= (others => '0');
+								s_xfer_write <= s_command(5) and not (s_command(6) and not s_command(4));
+							end if;
+							if i_cpu_dout(1) = '1' then
+								-- Complete command
+								s_phase <= "00";
+								s_xfer <= '0';
+								s_drq <= '0';
+								s_busy <= '0';
+								s_intrq <= '1';
+							end if;
+							if i_cpu_dout(2) = '1' then
+								-- Motors stopped acknowledged
+								s_motor_stopped <= '0';
+							end if;
+
+						when "100" =>
+							s_drive_present <= i_cpu_dout(3 downto 0);
+							s_write_protect <= i_cpu_dout(7 downto 4);
+
+						when "101" =>
+							s_buf_ptr <= (others => '0');
+
+						when "110" =>
+							s_buf_ptr <= s_buf_ptr + 1;
+
+						when others =>
+							null;
+					end case;
+				end if;
+
+				if s_syscon_rd_buf = '1' then
+					s_buf_ptr <= s_buf_ptr + 1;
+				end if;
+
+			end if;
+		end if;
+	end process;
+
+	o_syscon_irq <= '1' when s_phase /= "00" or s_motor_stopped = '1' else '0';
+
+	-- TRS-80 reads
+	o_cpu_din <=
+		x"FF" when s_any_drives = '0' else
+		s_rtc_int & s_intrq & "000000" when i_cpu_addr(3 downto 2) = "00" else
+		s_status when i_cpu_addr = x"C" else
+		s_track when i_cpu_addr = x"D" else
+		s_sector when i_cpu_addr = x"E" else
+		s_buf_dout when i_cpu_addr = x"F" and s_xfer = '1' and s_xfer_write = '0' else
+		s_data when i_cpu_addr = x"F" else
+		x"FF";
+
+	-- SysCon reads
+	with i_syscon_port_number select o_syscon_din <=
+		s_command when "000",
+		"0000" & s_drive_select when "001",
+		s_track when "010",
+		s_sector when "011",
+		std_logic_vector(s_phys_track(s_drive)) when "100",
+		"00000" & s_motor_stopped & s_phase when "101",
+		s_buf_dout when "110",
+		s_data when others;
+
+end;
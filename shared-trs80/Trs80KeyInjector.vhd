@@ -0,0 +1,118 @@
+--------------------------------------------------------------------------
+--
+-- Trs80KeyInjector
+--
+-- Lets the syscon "press" keys on the TRS-80 keyboard matrix by writing
+-- row bit patterns that are OR'd with the real keyboard.  Also counts
+-- keyboard scans (TRS-80 reads of 0x3801 - the first row read by the
+-- Level II ROM's scan routine) so the syscon can hold each key for
+-- just long enough to be seen.
+--
+-- Ports (relative to base port):
+--
+--   0-7 - write: injected key bits for rows 0-7 (0x3801 - 0x3880)
+--   8   - read: free running scan counter
+--         write: number of scans to wait.  o_irq asserts once that many
+--                scans have been seen and stays asserted until the next
+--                write (writing 0 clears the irq without arming it)
+--   9   - write: release all injected keys
+--
+-- Copyright (C) 2019 Topten Software.  All Rights Reserved.
+--
+--------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.ALL;
+use ieee.numeric_std.ALL;
+
+entity Trs80KeyInjector is
+port
+(
+	-- Control
+	i_clock : in std_logic;                         -- Clock
+	i_reset : in std_logic;                         -- Reset (synchronous, active high)
+
+	-- Syscon CPU interface
+	i_cpu_port_number : in std_logic_vector(3 downto 0);
+	i_cpu_port_wr_rising_edge : in std_logic;
+	o_cpu_din : out std_logic_vector(7 downto 0);
+	i_cpu_dout : in std_logic_vector(7 downto 0);
+	o_irq : out std_logic;
+
+	-- TRS-80 keyboard interface
+	i_addr : in std_logic_vector(7 downto 0);		-- Lowest 8 bits of keyboard address being read
+	i_scan : in std_logic;							-- Pulse when TRS-80 reads the first keyboard row
+	o_data : out std_logic_vector(7 downto 0)		-- Injected key bits for i_addr
+);
+end Trs80KeyInjector;
+
+architecture behavior of Trs80KeyInjector is
+	type row_array is array(0 to 7) of std_logic_vector(7 downto 0);
+	signal s_rows : row_array;
+	signal s_scan_count : unsigned(7 downto 0);
+	signal s_scans_remaining : unsigned(7 downto 0);
+	signal s_armed : std_logic;
+	signal s_irq : std_logic;
+begin
+
+	o_irq <= s_irq;
+	o_cpu_din <= std_logic_vector(s_scan_count);
+
+	process(i_clock)
+	begin
+		if rising_edge(i_clock) then
+			if i_reset = '1' then
+				s_rows <= (others => (others => '0'));
+				s_scan_count <= (others => '0');
+				s_scans_remaining <= (others => '0');
+				s_armed <= '0';
+				s_irq <= '0';
+			else
+
+				-- Count scans
+				if i_scan = '1' then
+					s_scan_count <= s_scan_count + 1;
+					if s_armed = '1' then
+						if s_scans_remaining = 1 then
+							s_armed <= '0';
+							s_irq <= '1';
+						end if;
+						s_scans_remaining <= s_scans_remaining - 1;
+					end if;
+				end if;
+
+				-- Port writes
+				if i_cpu_port_wr_rising_edge = '1' then
+					if i_cpu_port_number(3) = '0' then
+						s_rows(to_integer(unsigned(i_cpu_port_number(2 downto 0)))) <= i_cpu_dout;
+					elsif i_cpu_port_number = "1000" then
+						s_scans_remaining <= unsigned(i_cpu_dout);
+						s_irq <= '0';
+						if i_cpu_dout = x"00" then
+							s_armed <= '0';
+						else
+							s_armed <= '1';
+						end if;
+					elsif i_cpu_port_number = "1001" then
+						s_rows <= (others => (others => '0'));
+					end if;
+				end if;
+
+			end if;
+		end if;
+	end process;
+
+	-- Combine selected rows (the same way as Trs80KeyMemoryMap)
+	process(i_addr, s_rows)
+		variable v_data : std_logic_vector(7 downto 0);
+	begin
+		v_data := x"00";
+		for i in 0 to 7 loop
+			if i_addr(i) = '1' then
+				v_data := v_data or s_rows(i);
+			end if;
+		end loop;
+		o_data <= v_data;
+	end process;
+
+end;
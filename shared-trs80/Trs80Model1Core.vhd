@@ -20,7 +20,10 @@ generic
 	p_enable_keyboard : boolean := true;
 	p_enable_cassette_player : boolean := true;
 	p_enable_trisstick : boolean := true;
-	p_enable_syscon_serial : boolean := true
+	p_enable_syscon_serial : boolean := true;
+	p_enable_floppy : boolean := true;
+	p_sd_clock_div_init : integer := 200;			-- SPI clock divider during card init (400Khz)
+	p_sd_clock_div_fast : integer := 4				-- SPI clock divider once initialized (20Mhz, must be >= 4)
 );
 port
 (
@@ -37,9 +40,12 @@ port
 	o_status : out std_logic_vector(7 downto 0);
 	o_debug : out std_logic_vector(31 downto 0);
 
-	-- External RAM (128K required)
+	-- External RAM (256K required)
+	--   0x00000 -> 0x0FFFF = TRS-80 
+	--   0x10000 -> 0x1FFFF = SysCon
+	--   0x20000 -> 0x3FFFF = Spare (only accessible via page bank)
 	o_ram_cs : out std_logic;
-	o_ram_addr : out std_logic_vector(16 downto 0);
+	o_ram_addr : out std_logic_vector(17 downto 0);
 	o_ram_din : out std_logic_vector(7 downto 0);
 	i_ram_dout : in std_logic_vector(7 downto 0);
 	o_ram_rd : out std_logic;
@@ -63,6 +69,7 @@ port
 	-- Serial I/O
 	o_uart_tx : out std_logic;
 	i_uart_rx : in std_logic;
+	o_uart_rts_n : out std_logic;
 
 	-- SD Card
 	o_sd_mosi : out std_logic;
@@ -95,15 +102,41 @@ architecture behavior of Trs80Model1Core is
 	signal s_clken_cpu : std_logic;
 	signal s_turbo_mode : std_logic;
 
+	-- CPU Speed Profiles
+	signal s_is_syscon_speed_port : std_logic;
+	signal s_speed : std_logic_vector(3 downto 0) := (others => '0');
+	signal s_speed_period : integer range 1 to 45;
+	signal s_speed_divider : integer range 0 to 44 := 0;
+	signal s_speed_max : std_logic;
+	signal s_auto_turbo : std_logic;
+	signal s_auto_turbo_in_rom : std_logic;
+	constant c_auto_turbo_holdoff : integer := 80_000_000 / 20;		-- 50ms
+	signal s_auto_turbo_holdoff : integer range 0 to c_auto_turbo_holdoff := 0;
+
+	-- Performance Counters
+	signal s_is_syscon_perf_port : std_logic;
+	signal s_syscon_perf_port_wr_rising_edge : std_logic;
+	signal s_syscon_perf_cpu_din : std_logic_vector(7 downto 0);
+	signal s_perf_events : std_logic_vector(7 downto 0);
+	signal s_cas_block_requested : std_logic;
+	signal s_cas_prev_need_block_number : std_logic;
+	signal s_cas_underrun : std_logic;
+	signal s_cas_record_full : std_logic;
+	signal s_cas_stall : std_logic;
+	signal s_cas_status_stalled : std_logic;
+	signal s_cas_stall_cpu : std_logic;
+
 	-- Switches
 	signal s_is_syscon_options_port : std_logic;
-	signal s_options : std_logic_vector(5 downto 0) := (others => '1');
+	signal s_is_syscon_sd_clock_port : std_logic;
+	signal s_options : std_logic_vector(7 downto 0) := "00111111";
 	signal s_option_turbo_tape : std_logic;
 	signal s_option_typing_mode : std_logic;
 	signal s_option_green_screen : std_logic;
 	signal s_option_no_scan_lines : std_logic;
 	signal s_option_cas_audio : std_logic;
 	signal s_option_auto_cas : std_logic;
+	signal s_option_fast_save : std_logic;
 
 	-- SD Card Controller
 	signal s_sd_status : std_logic_vector(7 downto 0);
@@ -137,12 +170,14 @@ architecture behavior of Trs80Model1Core is
 	signal s_cpu_wr_n : std_logic;
 	signal s_cpu_wait_n : std_logic;
 	signal s_cpu_nmi_n : std_logic;
+	signal s_cpu_int_n : std_logic;
 	signal s_cpu_m1_n : std_logic;
 
 	-- Memory/Port Mapping
 	signal s_mem_rd : std_logic;
 	signal s_mem_wr : std_logic;
 	signal s_mem_rd_rising_edge : std_logic;
+	signal s_mem_rd_falling_edge : std_logic;
 	signal s_mem_wr_rising_edge : std_logic;
 	signal s_port_rd : std_logic;
 	signal s_port_wr : std_logic;
@@ -167,7 +202,7 @@ architecture behavior of Trs80Model1Core is
 	-- Interrupt Controller
 	signal s_is_syscon_ic_port : std_logic;
 	signal s_syscon_ic_cpu_din : std_logic_vector(7 downto 0);
-	signal s_irqs : std_logic_vector(4 downto 0);
+	signal s_irqs : std_logic_vector(7 downto 0);
 
 	-- Video RAM
 	signal s_is_vram_range : std_logic;
@@ -176,6 +211,12 @@ architecture behavior of Trs80Model1Core is
 	signal s_vram_din_cpu : std_logic_vector(7 downto 0);
 	signal s_vram_dout_cpu : std_logic_vector(7 downto 0);
 
+	-- Screen mirror
+	signal s_is_syscon_screen_port : std_logic;
+	signal s_screen_addr : unsigned(9 downto 0);
+	signal s_screen_dirty : std_logic_vector(15 downto 0);
+	signal s_syscon_screen_cpu_din : std_logic_vector(7 downto 0);
+
 	-- ROM
 	signal s_is_rom_range : std_logic;
 
@@ -198,6 +239,7 @@ architecture behavior of Trs80Model1Core is
 
 	-- Keyboard Controller
 	signal s_is_keyboard_range : std_logic;
+	signal s_is_fdc_range : std_logic;
 	signal s_key_scancode : std_logic_vector(7 downto 0);
 	signal s_key_release : std_logic;
 	signal s_key_available : std_logic;
@@ -212,6 +254,14 @@ architecture behavior of Trs80Model1Core is
 	signal s_syscon_keyboard_port_rd_falling_edge : std_logic;
 	signal s_syscon_keyboard_cpu_din : std_logic_vector(7 downto 0);
 
+	-- Key injection
+	signal s_key_matrix_dout : std_logic_vector(7 downto 0);
+	signal s_key_inject_dout : std_logic_vector(7 downto 0);
+	signal s_key_scan : std_logic;
+	signal s_is_syscon_key_inject_port : std_logic;
+	signal s_syscon_key_inject_port_wr_rising_edge : std_logic;
+	signal s_syscon_key_inject_cpu_din : std_logic_vector(7 downto 0);
+
 	-- Media Keys
 	signal s_key_press : std_logic;
 
@@ -219,8 +269,10 @@ architecture behavior of Trs80Model1Core is
 	signal s_is_syscon_cas_port : std_logic;			-- x"C?"
 	signal s_is_syscon_cas_cmdstat_port : std_logic;	-- x"C0"
 	signal s_is_syscon_cas_data_port : std_logic;		-- x"C1"
+	signal s_is_syscon_cas_direct_port : std_logic;		-- x"C2"
 	signal s_clken_cassette : std_logic;
 	signal s_is_cas_port : std_logic;
+	signal s_is_cas_fast_port : std_logic;
 	signal s_cas_prev_audio_in : std_logic_vector(1 downto 0);
 	signal s_cas_audio_in : std_logic_vector(1 downto 0);
 	signal s_cas_audio_out : std_logic_vector(1 downto 0);
@@ -242,6 +294,9 @@ architecture behavior of Trs80Model1Core is
 	signal s_syscon_cas_record : std_logic;
 	signal s_syscon_cas_stop : std_logic;
 	signal s_syscon_cas_block_number_load : std_logic;
+	signal s_syscon_cas_direct_load : std_logic;
+	signal s_syscon_cas_direct_data_cycle : std_logic;
+	signal s_cas_fast_data_cycle : std_logic;
 
 	-- Auto cassette control
 	signal s_cas_motor_monitored : std_logic;
@@ -261,6 +316,23 @@ architecture behavior of Trs80Model1Core is
 	signal s_syscon_serial_port_wr_rising_edge : std_logic;
 	signal s_syscon_serial_port_rd_falling_edge : std_logic;
 	signal s_syscon_serial_cpu_din : std_logic_vector(7 downto 0);
+	signal s_syscon_serial_irq_rx : std_logic;
+	signal s_is_syscon_serial_fifo_port : std_logic;
+	signal s_syscon_serial_fifo_port_wr_rising_edge : std_logic;
+	signal s_syscon_serial_fifo_port_rd_falling_edge : std_logic;
+	signal s_syscon_serial_fifo_cpu_din : std_logic_vector(7 downto 0);
+	signal s_syscon_serial_fifo_enabled : std_logic;
+	signal s_syscon_serial_overrun : std_logic;
+
+	-- Floppy Disk Controller
+	signal s_is_syscon_fdc_port : std_logic;
+	signal s_syscon_fdc_port_wr_rising_edge : std_logic;
+	signal s_syscon_fdc_port_rd_falling_edge : std_logic;
+	signal s_syscon_fdc_cpu_din : std_logic_vector(7 downto 0);
+	signal s_fdc_mem_wr_rising_edge : std_logic;
+	signal s_fdc_mem_rd_falling_edge : std_logic;
+	signal s_fdc_dout_cpu : std_logic_vector(7 downto 0);
+	signal s_fdc_cpu_int : std_logic;
 
 	-- SysCon Disk
 	signal s_is_syscon_disk_port : std_logic;
@@ -330,29 +402,54 @@ begin
 		end if;
 	end process;
 
-	-- Generate CPU clock enable (1.774Mhz)
-	-- (80Mhz / 45 = 1.777Mhz)
-	clock_div_cpu_1774 : entity work.ClockDivider
-	generic map
-	(
-		p_period => 45
-	)
-	port map
-	(
-		i_clock => i_clock_80mhz,
-		i_clken => '1',
-		i_reset => s_reset,
-		o_clken => s_clken_cpu_normal
-	);
+	-- Generate CPU clock enable for the selected speed profile
+	-- (80Mhz / 45 = 1.777Mhz, / 22 = 3.636Mhz, / 11 = 7.272Mhz, / 6 = 13.33Mhz)
+	s_speed_period <= 
+		22 when s_speed(2 downto 0) = "001" else
+		11 when s_speed(2 downto 0) = "010" else
+		6 when s_speed(2 downto 0) = "011" else
+		45;
+	s_speed_max <= '1' when s_speed(2) = '1' else '0';
+
+	clock_div_cpu : process(i_clock_80mhz)
+	begin
+		if rising_edge(i_clock_80mhz) then
+			if s_reset = '1' then
+				s_speed_divider <= 0;
+				s_clken_cpu_normal <= '0';
+			elsif s_speed_divider >= s_speed_period - 1 then
+				s_speed_divider <= 0;
+				s_clken_cpu_normal <= '1';
+			else
+				s_speed_divider <= s_speed_divider + 1;
+				s_clken_cpu_normal <= '0';
+			end if;
+		end if;
+	end process;
 
 
 	s_clken_cpu <= 
 		'0' when i_switch_run = '0' else 
 		s_clken_40mhz when s_hijacked = '1' else
+		'0' when s_cas_stall_cpu = '1' else
 		s_clken_40mhz when s_turbo_mode = '1' else
+		s_clken_40mhz when s_speed_max = '1' else
 		s_clken_cpu_normal;
 	o_clken_cpu <= s_clken_cpu;
-	s_turbo_mode <= s_cas_motor and s_option_turbo_tape;
+
+	-- Fast save only speeds up recording, playback (eg: CLOAD) runs at
+	-- normal speed unless turbo tape is on too.
+	s_turbo_mode <= (s_cas_motor and (s_option_turbo_tape or (s_option_fast_save and s_cas_status_recording))) or s_auto_turbo;
+
+	-- Stop the TRS-80 while cassette playback is stalled waiting for the SD
+	-- card so it never sees a gap in the audio.  If the block number hasn't 
+	-- been supplied yet, or an NMI is pending, keep running so the syscon can
+	-- get in to service it.
+	-- Fast save is held off the same way while the record buffer is full, 
+	-- but the syscon always answers record block requests so it's held 
+	-- even while waiting for the block number.
+	s_cas_stall_cpu <= 
+		((s_cas_stall and not s_cas_status_need_block_number) or s_cas_record_full) and s_cpu_nmi_n;
 
 	
 	
@@ -378,7 +475,7 @@ begin
 		RD_n => s_cpu_rd_n,
 		WR_n => s_cpu_wr_n,
 		WAIT_n => s_cpu_wait_n,
-		INT_n => '1',
+		INT_n => s_cpu_int_n,
 		NMI_n => s_cpu_nmi_n,
 		BUSRQ_n => '1',
 		M1_n => s_cpu_m1_n,
@@ -390,6 +487,10 @@ begin
 	-- Generate wait
 	s_cpu_wait_n <= not i_ram_wait;
 
+	-- Expansion interface interrupts (clock and FDC), never while the 
+	-- syscon has the CPU
+	s_cpu_int_n <= not (s_fdc_cpu_int and not s_hijacked);
+
 	-- Decode I/O control signals from cpu
 	s_mem_rd <= '1' when (s_cpu_mreq_n = '0' and s_cpu_iorq_n = '1' and s_cpu_rd_n = '0') else '0';
 	s_mem_wr <= '1' when (s_cpu_mreq_n = '0' and s_cpu_iorq_n = '1' and s_cpu_wr_n = '0') else '0';
@@ -413,6 +514,7 @@ begin
 		s_is_vram_range <= '0';
 		s_is_ram_range <= '0';
 		s_is_keyboard_range <= '0';
+		s_is_fdc_range <= '0';
 
 		if s_hijacked = '1' then
 			if s_apm_bootmode = '1' and s_cpu_addr(15) = '0' then
@@ -427,13 +529,13 @@ begin
 			end if;
 
 			if s_cpu_addr(15 downto 10) = "111111" and s_apm_pagebank_enabled='1' then
-				o_ram_addr <= s_apm_pagebank(6 downto 0) & s_cpu_addr(9 downto 0);
+				o_ram_addr <= s_apm_pagebank & s_cpu_addr(9 downto 0);
 			else
-				o_ram_addr <= '1' & s_cpu_addr;
+				o_ram_addr <= "01" & s_cpu_addr;
 			end if;
 		else
 
-			o_ram_addr <= '0' & s_cpu_addr;
+			o_ram_addr <= "00" & s_cpu_addr;
 
 			if s_cpu_addr(15 downto 14) /= "00" then
 				-- RAM 0x4000 -> 0x7FFF
@@ -444,6 +546,9 @@ begin
 			elsif s_cpu_addr(15 downto 10) = "001110" then
 				-- Keyboard 0x3800 -> 0x3BFF (shadowed 4 times)
 				s_is_keyboard_range <= '1';
+			elsif s_cpu_addr(15 downto 4) = x"37E" then
+				-- Expansion interface 0x37E0 -> 0x37EF
+				s_is_fdc_range <= '1';
 			elsif s_cpu_addr(15 downto 12) = "0000" or s_cpu_addr(15 downto 12) = "0001" or s_cpu_addr(15 downto 12) = "0010" then
 				-- ROM 0x0000 -> 0x2FFF
 				s_is_rom_range <= '1';
@@ -460,14 +565,19 @@ begin
 							s_is_ram_range, i_ram_dout, 
 							s_is_vram_range, s_vram_dout_cpu,
 							s_is_keyboard_Range, s_key_dout_cpu,
+							s_is_fdc_range, s_fdc_dout_cpu,
 							s_is_syscon_vram_char_range, s_syscon_vram_char_dout_cpu,
 							s_is_syscon_vram_color_range, s_syscon_vram_color_dout_cpu,
 						s_port_rd,
 							s_is_cas_port, s_cas_audio_in, s_cas_audio_in_edge,
 							s_is_trisstick_port, s_psx_buttons,
 						    s_is_syscon_serial_port, s_syscon_serial_cpu_din,
+						    s_is_syscon_serial_fifo_port, s_syscon_serial_fifo_cpu_din,
 						    s_is_syscon_disk_port, s_syscon_disk_cpu_din,
 							s_is_syscon_options_port, s_options,
+							s_is_syscon_speed_port, s_speed,
+							s_is_syscon_sd_clock_port,
+							s_is_syscon_perf_port, s_syscon_perf_cpu_din,
 							s_is_syscon_ic_port , s_syscon_ic_cpu_din,
 							s_is_apm_enable_port,
 							s_is_apm_pagebank_port, 
@@ -476,10 +586,14 @@ begin
 							s_all_keys,
 							s_is_syscon_keyboard_port,
 							s_syscon_keyboard_cpu_din,
+							s_is_syscon_fdc_port, s_syscon_fdc_cpu_din,
+							s_is_syscon_key_inject_port, s_syscon_key_inject_cpu_din,
+							s_is_syscon_screen_port, s_syscon_screen_cpu_din,
 							s_is_syscon_cas_cmdstat_port,
 							s_cas_status_playing,
 							s_cas_status_recording,
-							s_cas_status_need_block_number
+							s_cas_status_need_block_number,
+							s_cas_status_stalled
 							)
 	begin
 
@@ -493,6 +607,8 @@ begin
 				s_cpu_din <= i_ram_dout;
 			elsif s_is_keyboard_range = '1' then
 				s_cpu_din <= s_key_dout_cpu;
+			elsif s_is_fdc_range = '1' then
+				s_cpu_din <= s_fdc_dout_cpu;
 			elsif s_is_vram_range = '1' then
 				s_cpu_din <= s_vram_dout_cpu;
 			elsif s_is_syscon_vram_char_range = '1' then
@@ -523,16 +639,30 @@ begin
 				s_cpu_din <= s_syscon_disk_cpu_din;
 			elsif s_is_syscon_serial_port = '1' then 
 				s_cpu_din <= s_syscon_serial_cpu_din;
+			elsif s_is_syscon_serial_fifo_port = '1' then 
+				s_cpu_din <= s_syscon_serial_fifo_cpu_din;
 			elsif s_is_syscon_options_port = '1' then
-				s_cpu_din <= "00" & s_options;
+				s_cpu_din <= s_options;
+			elsif s_is_syscon_speed_port = '1' then
+				s_cpu_din <= "0000" & s_speed;
+			elsif s_is_syscon_sd_clock_port = '1' then
+				s_cpu_din <= std_logic_vector(to_unsigned(80 / p_sd_clock_div_fast, 8));
+			elsif s_is_syscon_perf_port = '1' then
+				s_cpu_din <= s_syscon_perf_cpu_din;
 			elsif s_is_apm_pagebank_port = '1' then
 				s_cpu_din <= s_apm_pagebank;
 			elsif s_is_apm_enable_port = '1' then
 				s_cpu_din <= "000" & s_all_keys & s_syscon_show_video & s_apm_pagebank_enabled & s_apm_bootmode & s_apm_videobank_enabled;
 			elsif s_is_syscon_keyboard_port = '1' then
 				s_cpu_din <= s_syscon_keyboard_cpu_din;
+			elsif s_is_syscon_fdc_port = '1' then
+				s_cpu_din <= s_syscon_fdc_cpu_din;
+			elsif s_is_syscon_key_inject_port = '1' then
+				s_cpu_din <= s_syscon_key_inject_cpu_din;
+			elsif s_is_syscon_screen_port = '1' then
+				s_cpu_din <= s_syscon_screen_cpu_din;
 			elsif s_is_syscon_cas_cmdstat_port = '1' then
-				s_cpu_din <= "00000" & s_cas_status_need_block_number & s_cas_status_recording & s_cas_status_playing;
+				s_cpu_din <= "0000" & s_cas_status_stalled & s_cas_status_need_block_number & s_cas_status_recording & s_cas_status_playing;
 			end if;
 
 		end if;
@@ -561,6 +691,22 @@ begin
 		o_pulse => s_mem_rd_rising_edge
 	);
 
+	-- Detect mem read falling edges
+	mem_rd_falling_edge : entity work.EdgeDetector
+	generic map
+	(
+		p_falling_edge => true,
+		p_rising_edge => false
+	)
+	port map
+	( 
+		i_clock => i_clock_80mhz,
+		i_clken => s_clken_cpu,
+		i_reset => s_reset,
+		i_signal => s_mem_rd,
+		o_pulse => s_mem_rd_falling_edge
+	);
+
 	-- Detect port write rising edges
 	port_wr_rising_edge : entity work.EdgeDetector
 	port map
@@ -634,7 +780,7 @@ begin
 	interrupt_controller : entity work.SysConInterruptController
 	generic map
 	(
-		p_irq_count => 5
+		p_irq_count => 8
 	)
 	port map
 	(
@@ -667,32 +813,165 @@ begin
 	s_option_no_scan_lines <= s_options(3);
 	s_option_cas_audio <= s_options(4);
 	s_option_auto_cas <= s_options(5);
+	s_option_fast_save <= s_options(6);
 
 	-- Listen for writes to options port
 	options_port_handler : process(i_clock_80mhz)
 	begin
 		if rising_edge(i_clock_80mhz) then
 			if s_reset = '1' then
-				s_options <= (others => '1');
+				s_options <= "00111111";
 			elsif s_hijacked = '1' then
 
 				if s_port_wr_rising_edge = '1' and s_is_syscon_options_port = '1' then
-					s_options <= s_cpu_dout(5 downto 0);
+					s_options <= s_cpu_dout;
+				end if;
+
+			end if;
+		end if;
+	end process;
+
+
+
+	------------------------- CPU Speed -------------------------
+
+	-- Bits 0..2 select the speed (0=1.77Mhz, 1=3.5Mhz, 2=7Mhz, 3=14Mhz, 4+=40Mhz)
+	-- Bit 3 enables auto turbo
+	s_is_syscon_speed_port <= s_hijacked when s_cpu_addr(7 downto 0) = x"01" else '0';
+
+	-- Listen for writes to speed port
+	speed_port_handler : process(i_clock_80mhz)
+	begin
+		if rising_edge(i_clock_80mhz) then
+			if s_reset = '1' then
+				s_speed <= (others => '0');
+			elsif s_hijacked = '1' then
+
+				if s_port_wr_rising_edge = '1' and s_is_syscon_speed_port = '1' then
+					s_speed <= s_cpu_dout(3 downto 0);
+				end if;
+
+			end if;
+		end if;
+	end process;
+
+	-- Auto turbo runs the CPU flat out while it's executing ROM code (cassette 
+	-- and disk routines, BASIC interpreter, delay loops etc...) but drops back to 
+	-- the selected speed when executing from RAM.  Key activity (a keyboard read
+	-- that sees a pressed or injected key) or sitting in the ROM's wait for key
+	-- loop holds off the turbo for 50ms so debounce and auto repeat behave as
+	-- they would on a real machine.  The BASIC interpreter scans the keyboard
+	-- between every statement so plain keyboard reads can't be used or running
+	-- programs would never be sped up.
+	auto_turbo : process(i_clock_80mhz)
+	begin
+		if rising_edge(i_clock_80mhz) then
+			if s_reset = '1' then
+				s_auto_turbo_in_rom <= '0';
+				s_auto_turbo_holdoff <= 0;
+			else
+
+				if s_auto_turbo_holdoff /= 0 then
+					s_auto_turbo_holdoff <= s_auto_turbo_holdoff - 1;
+				end if;
+
+				if s_hijacked = '0' and s_clken_cpu = '1' then
+
+					-- Track whether executing from ROM (0x0000 -> 0x2FFF)
+					if s_cpu_m1_n = '0' and s_mem_rd = '1' then
+						if s_cpu_addr(15 downto 12) = x"0" or s_cpu_addr(15 downto 12) = x"1" or s_cpu_addr(15 downto 12) = x"2" then
+							s_auto_turbo_in_rom <= '1';
+						else
+							s_auto_turbo_in_rom <= '0';
+						end if;
+					end if;
+
+					-- Hold off on key activity
+					if s_mem_rd = '1' and s_is_keyboard_range = '1' and s_key_dout_cpu /= x"00" then
+						s_auto_turbo_holdoff <= c_auto_turbo_holdoff;
+					end if;
+
+					-- Hold off in the wait for key loop (0x0049 -> 0x004F)
+					if s_cpu_m1_n = '0' and s_mem_rd = '1' and s_cpu_addr(15 downto 3) = "0000000001001" then
+						s_auto_turbo_holdoff <= c_auto_turbo_holdoff;
+					end if;
+
 				end if;
 
 			end if;
 		end if;
 	end process;
 
+	s_auto_turbo <= '1' when s_speed(3) = '1' and s_auto_turbo_in_rom = '1' and s_auto_turbo_holdoff = 0 else '0';
+
+
+
+	------------------------- Performance Counters -------------------------
+
+	-- Free running event counters (see SysConPerfCounters.vhd) on ports 0xB0 -> 0xB4:
+	--   0 - 80Mhz clock cycles
+	--   1 - TRS-80 CPU cycles (clock enables while not hijacked)
+	--   2 - TRS-80 CPU cycles stalled waiting on external RAM
+	--   3 - clock cycles hijacked by the syscon
+	--   4 - clock cycles the SD card controller was busy
+	--   5 - cassette blocks requested
+	--   6 - cassette blocks served late (playback underruns)
+	--   7 - serial receive fifo overruns
+	s_is_syscon_perf_port <= s_hijacked when s_cpu_addr(7 downto 3) = "10110" else '0';
+	s_syscon_perf_port_wr_rising_edge <= s_is_syscon_perf_port and s_port_wr_rising_edge;
+
+	s_perf_events(0) <= '1';
+	s_perf_events(1) <= s_clken_cpu and not s_hijacked;
+	s_perf_events(2) <= s_clken_cpu and i_ram_wait and not s_hijacked;
+	s_perf_events(3) <= s_hijacked;
+	s_perf_events(4) <= s_sd_status(0);
+	s_perf_events(5) <= s_cas_block_requested;
+	s_perf_events(6) <= s_cas_underrun;
+	s_perf_events(7) <= s_syscon_serial_overrun;
+
+	-- Rising edge of the cassette controller's need block number status
+	cas_block_request_edge : process(i_clock_80mhz)
+	begin
+		if rising_edge(i_clock_80mhz) then
+			if s_reset = '1' then
+				s_cas_prev_need_block_number <= '0';
+			else
+				s_cas_prev_need_block_number <= s_cas_status_need_block_number;
+			end if;
+		end if;
+	end process;
+	s_cas_block_requested <= s_cas_status_need_block_number and not s_cas_prev_need_block_number;
+
+	perf_counters : entity work.SysConPerfCounters
+	generic map
+	(
+		p_counter_count => 8
+	)
+	port map
+	(
+		i_clock => i_clock_80mhz,
+		i_reset => s_reset,
+		i_cpu_port_number => s_cpu_addr(2 downto 0),
+		i_cpu_port_wr_rising_edge => s_syscon_perf_port_wr_rising_edge,
+		o_cpu_din => s_syscon_perf_cpu_din,
+		i_cpu_dout => s_cpu_dout,
+		i_events => s_perf_events
+	);
 
 
 	------------------------- SD Card Controller -------------------------
 
+	-- The card is never switched to high speed mode (CMD6) so it must be
+	-- clocked at no more than the 25Mhz default speed limit, hence the
+	-- fast divider of at least 4 (20Mhz from 80Mhz).  The rate is fixed
+	-- by the generic and the read only port reports it (in Mhz).
+	s_is_syscon_sd_clock_port <= s_hijacked when s_cpu_addr(7 downto 0) = x"02" else '0';
+
 	sdcard : entity work.SDCardControllerDualPort
 	generic map
 	(
-		p_clock_div_800khz => 100,
-		p_clock_div_50mhz => 2
+		p_clock_div_800khz => p_sd_clock_div_init,
+		p_clock_div_50mhz => p_sd_clock_div_fast
 	)
 	port map
 	(
@@ -753,7 +1032,9 @@ begin
 
 	------------------------- Video RAM -------------------------
 
-	s_vram_addr_cpu <= s_cpu_addr(9 downto 0);
+	-- While hijacked the syscon reads video RAM through the screen mirror 
+	-- ports instead (the TRS-80 can't be accessing it)
+	s_vram_addr_cpu <= std_logic_vector(s_screen_addr) when s_hijacked = '1' else s_cpu_addr(9 downto 0);
 	s_vram_write_cpu <= s_mem_wr and s_is_vram_range;
 	s_vram_din_cpu <= s_cpu_dout;
 
@@ -781,6 +1062,52 @@ begin
 		o_dout_b => s_vram_data
 	);
 
+	-- Screen mirror ports let the syscon send the TRS-80 screen over the 
+	-- serial port (see cmd_screen in uart_fiber.c).  Each 64 column row
+	-- has a dirty flag that's set when the TRS-80 writes to it.
+	--   0xF0 - write: select row (0-15) and clear its dirty flag
+	--          read: dirty flags for rows 0-7
+	--   0xF1 - read: next byte of the selected row
+	--   0xF2 - read: dirty flags for rows 8-15
+	s_is_syscon_screen_port <= s_hijacked when s_cpu_addr(7 downto 4) = x"F" else '0';
+
+	s_syscon_screen_cpu_din <= 
+		s_screen_dirty(7 downto 0) when s_cpu_addr(1 downto 0) = "00" else
+		s_vram_dout_cpu when s_cpu_addr(1 downto 0) = "01" else
+		s_screen_dirty(15 downto 8) when s_cpu_addr(1 downto 0) = "10" else
+		x"FF";
+
+	screen_port_handler : process(i_clock_80mhz)
+	begin
+		if rising_edge(i_clock_80mhz) then
+			if s_reset = '1' then
+				s_screen_addr <= (others => '0');
+				s_screen_dirty <= (others => '1');
+			else
+
+				-- TRS-80 writes mark the row dirty
+				if s_vram_write_cpu = '1' then
+					s_screen_dirty(to_integer(unsigned(s_cpu_addr(9 downto 6)))) <= '1';
+				end if;
+
+				if s_is_syscon_screen_port = '1' then
+
+					-- Select row
+					if s_port_wr_rising_edge = '1' and s_cpu_addr(1 downto 0) = "00" then
+						s_screen_addr <= unsigned(s_cpu_dout(3 downto 0)) & "000000";
+						s_screen_dirty(to_integer(unsigned(s_cpu_dout(3 downto 0)))) <= '0';
+					end if;
+
+					-- Next byte
+					if s_port_rd_falling_edge = '1' and s_cpu_addr(1 downto 0) = "01" then
+						s_screen_addr <= s_screen_addr + 1;
+					end if;
+
+				end if;
+			end if;
+		end if;
+	end process;
+
 
 
 	------------------------- ROM -------------------------
@@ -924,6 +1251,9 @@ begin
 		s_key_release <= '0';
 		s_key_available <= '1';
 		s_key_press <= '0';
+		s_is_syscon_key_inject_port <= '0';
+		s_syscon_key_inject_cpu_din <= (others => '0');
+		s_irqs(7) <= '0';
 	end generate;
 
 	with_keyboard : if p_enable_keyboard generate
@@ -955,7 +1285,7 @@ begin
 			i_key_available => s_key_available,
 			i_typing_mode => s_option_typing_mode,
 			i_addr => s_cpu_addr(7 downto 0),
-			o_data => s_key_dout_cpu,
+			o_data => s_key_matrix_dout,
 			o_is_other_key => s_is_other_key,
 			o_modifiers => s_key_modifiers,
 			i_suppress_all_keys => s_all_keys
@@ -985,6 +1315,31 @@ begin
 			i_all_keys => s_all_keys
 		);
 
+		-- Keys injected by syscon are merged with the real keyboard
+		s_key_dout_cpu <= s_key_matrix_dout or s_key_inject_dout;
+
+		-- The Level II ROM's keyboard scan starts by reading 0x3801
+		s_key_scan <= s_mem_rd_falling_edge when s_is_keyboard_range = '1' and s_cpu_addr(7 downto 0) = x"01" else '0';
+
+		s_is_syscon_key_inject_port <= s_hijacked when s_cpu_addr(7 downto 4) = x"E" else '0';
+		s_syscon_key_inject_port_wr_rising_edge <= s_is_syscon_key_inject_port and s_port_wr_rising_edge;
+
+		-- SysCon Key Injector
+		e_Trs80KeyInjector : entity work.Trs80KeyInjector
+		port map
+		(
+			i_clock => i_clock_80mhz,
+			i_reset => s_reset,
+			i_cpu_port_number => s_cpu_addr(3 downto 0),
+			i_cpu_port_wr_rising_edge => s_syscon_key_inject_port_wr_rising_edge,
+			o_cpu_din => s_syscon_key_inject_cpu_din,
+			i_cpu_dout => s_cpu_dout,
+			o_irq => s_irqs(7),
+			i_addr => s_cpu_addr(7 downto 0),
+			i_scan => s_key_scan,
+			o_data => s_key_inject_dout
+		);
+
 
 	end generate;
 
@@ -994,6 +1349,11 @@ begin
 
 	s_is_cas_port <= not s_hijacked when (s_cpu_addr(7 downto 0) = x"FF") else '0';
 
+	-- Fast save port.  When fast save is enabled the syscon patches the ROM's
+	-- cassette byte write routine (0264h) to output the byte here instead
+	-- of bit banging it out port FFh.
+	s_is_cas_fast_port <= s_option_fast_save and not s_hijacked when (s_cpu_addr(7 downto 0) = x"FE") else '0';
+
 	without_cassette_player : if not p_enable_cassette_player generate
 		s_cas_audio_out	<= (others => '0');
 		s_cas_audio_in <= (others => '0');
@@ -1005,16 +1365,23 @@ begin
 		s_sd_din_a <= (others => '0');
 		s_cas_status_recording <= '0';
 		s_cas_status_playing <= '0';
+		s_cas_status_need_block_number <= '0';
 		s_cas_audio_in_edge <= '0';
 		s_clken_cassette <= '0';
+		s_cas_underrun <= '0';
+		s_cas_stall <= '0';
+		s_cas_record_full <= '0';
+		s_cas_fast_data_cycle <= '0';
+		s_cas_status_stalled <= '0';
 	end generate;
 
 	with_cassette_player : if p_enable_cassette_player generate
 
 		-- SysCon cassette port flags
 	    s_is_syscon_cas_port <= s_hijacked when s_cpu_addr(7 downto 4) = x"C" else '0';
-		s_is_syscon_cas_cmdstat_port <= s_is_syscon_cas_port and not s_cpu_addr(0);
-		s_is_syscon_cas_data_port <= s_is_syscon_cas_port and s_cpu_addr(0);
+		s_is_syscon_cas_cmdstat_port <= s_is_syscon_cas_port when s_cpu_addr(3 downto 0) = x"0" else '0';
+		s_is_syscon_cas_data_port <= s_is_syscon_cas_port when s_cpu_addr(3 downto 0) = x"1" else '0';
+		s_is_syscon_cas_direct_port <= s_is_syscon_cas_port when s_cpu_addr(3 downto 0) = x"2" else '0';
 
 		-- Disable cassette play/record when in hijacked mode
 		s_clken_cassette <= s_clken_cpu and not s_hijacked and s_cpu_wait_n;
@@ -1028,16 +1395,19 @@ begin
 					s_syscon_cas_record <= '0';
 					s_syscon_cas_stop <= '0';
 					s_syscon_cas_block_number_load <= '0';
+					s_syscon_cas_direct_load <= '0';
 				elsif s_clken_cpu = '1' then
 					s_syscon_cas_play <= '0';
 					s_syscon_cas_record <= '0';
 					s_syscon_cas_stop <= '0';
 					s_syscon_cas_block_number_load <= '0';
+					s_syscon_cas_direct_load <= '0';
 					if s_is_syscon_cas_cmdstat_port = '1' and s_port_wr_rising_edge = '1' then
 						s_syscon_cas_play <= s_cpu_dout(0);
 						s_syscon_cas_record <= s_cpu_dout(1);
 						s_syscon_cas_stop <= s_cpu_dout(2);
 						s_syscon_cas_block_number_load <= s_cpu_dout(3);
+						s_syscon_cas_direct_load <= s_cpu_dout(4);
 					end if;
 				end if;
 			end if;
@@ -1058,6 +1428,13 @@ begin
 			end if;
 		end process;
 
+		-- Syscon cassette direct data port (bytes of a block supplied by
+		-- the syscon instead of read from the SD card)
+		s_syscon_cas_direct_data_cycle <= s_is_syscon_cas_direct_port and s_port_wr_rising_edge;
+
+		-- Fast save bytes written by the TRS-80
+		s_cas_fast_data_cycle <= s_is_cas_fast_port and s_port_wr_rising_edge and s_clken_cpu;
+
 		-- Cassette Player
 		player : entity work.Trs80CassetteController
 		generic map
@@ -1077,9 +1454,15 @@ begin
 			o_status_playing => s_cas_status_playing,
 			o_status_recording => s_cas_status_recording,
 			o_status_need_block_number => s_cas_status_need_block_number,
+			o_status_stalled => s_cas_status_stalled,
 			o_irq => s_irqs(4),
 			i_block_number => s_cas_block_number,
 			i_block_number_load => s_cas_block_number_load,
+			i_direct_load => s_syscon_cas_direct_load,
+			i_direct_data => s_cpu_dout,
+			i_direct_data_cycle => s_syscon_cas_direct_data_cycle,
+			i_fast_data_cycle => s_cas_fast_data_cycle,
+			o_record_full => s_cas_record_full,
 			o_sd_op_wr => s_sd_op_write_a,
 			o_sd_op_cmd => s_sd_op_cmd_a,
 			o_sd_op_block_number => s_sd_op_block_number_a,
@@ -1088,7 +1471,9 @@ begin
 			i_sd_data => s_sd_dout_a,
 			o_sd_data => s_sd_din_a,
 			o_audio => s_cas_audio_in,
-			i_audio => s_cas_audio_out(0)
+			i_audio => s_cas_audio_out(0),
+			o_stall => s_cas_stall,
+			o_underrun => s_cas_underrun
 		);
 
 		cas_edge_detect : process(i_clock_80mhz)
@@ -1133,6 +1518,7 @@ begin
 			i_reset => s_reset,
 			i_motor => s_cas_motor_monitored,
 			i_audio => s_cas_audio_out(0),
+			i_data_cycle => s_cas_fast_data_cycle,
 			o_start => s_autocas_start,
 			o_record => s_autocas_record,
 			o_stop => s_autocas_stop
@@ -1195,12 +1581,21 @@ begin
 		s_syscon_serial_port_wr_rising_edge <= '0';
 		s_syscon_serial_port_rd_falling_edge <= '0';
 		s_syscon_serial_cpu_din <= (others => '0');
+		s_is_syscon_serial_fifo_port <= '0';
+		s_syscon_serial_fifo_cpu_din <= (others => '0');
+		s_syscon_serial_fifo_enabled <= '0';
+		s_syscon_serial_overrun <= '0';
+		s_irqs(0) <= '0';
+		s_irqs(1) <= '0';
+		s_irqs(5) <= '0';
 		o_uart_tx <= '1';
+		o_uart_rts_n <= '0';
 	end generate;
 
 	wo_serial : if p_enable_syscon_serial generate
 
-		s_is_syscon_serial_port <= s_hijacked when s_cpu_addr(7 downto 4) = x"8" else '0';
+		-- 0x80 -> 0x83 = serial port, 0x84 -> 0x87 = receive fifo
+		s_is_syscon_serial_port <= s_hijacked when s_cpu_addr(7 downto 2) = "100000" else '0';
 		s_syscon_serial_port_wr_rising_edge <= s_is_syscon_serial_port and s_port_wr_rising_edge;
 		s_syscon_serial_port_rd_falling_edge <= s_is_syscon_serial_port and s_port_rd_falling_edge;
 
@@ -1214,12 +1609,41 @@ begin
 			i_cpu_port_rd_falling_edge => s_syscon_serial_port_rd_falling_edge,
 			o_cpu_din => s_syscon_serial_cpu_din,
 			i_cpu_dout => s_cpu_dout,
-			o_irq_rx => s_irqs(0),
+			o_irq_rx => s_syscon_serial_irq_rx,
 			o_irq_tx => s_irqs(1),
 			o_uart_tx => o_uart_tx,
 			i_uart_rx => i_uart_rx
 		);
 
+		-- When the receive fifo is enabled, mask the serial port's own rx irq
+		s_irqs(0) <= s_syscon_serial_irq_rx and not s_syscon_serial_fifo_enabled;
+
+		s_is_syscon_serial_fifo_port <= s_hijacked when s_cpu_addr(7 downto 2) = "100001" else '0';
+		s_syscon_serial_fifo_port_wr_rising_edge <= s_is_syscon_serial_fifo_port and s_port_wr_rising_edge;
+		s_syscon_serial_fifo_port_rd_falling_edge <= s_is_syscon_serial_fifo_port and s_port_rd_falling_edge;
+
+		serial_rx_fifo : entity work.SysConSerialRxFifo
+		generic map
+		(
+			p_clock_hz => 80_000_000,
+			p_addr_width => 11
+		)
+		port map
+		(
+			i_clock => i_clock_80mhz,
+			i_reset => s_reset,
+			i_cpu_port_number => s_cpu_addr(1 downto 0),
+			i_cpu_port_wr_rising_edge => s_syscon_serial_fifo_port_wr_rising_edge,
+			i_cpu_port_rd_falling_edge => s_syscon_serial_fifo_port_rd_falling_edge,
+			o_cpu_din => s_syscon_serial_fifo_cpu_din,
+			i_cpu_dout => s_cpu_dout,
+			o_enabled => s_syscon_serial_fifo_enabled,
+			o_irq => s_irqs(5),
+			o_overrun => s_syscon_serial_overrun,
+			i_uart_rx => i_uart_rx,
+			o_uart_rts_n => o_uart_rts_n
+		);
+
 	end generate;
 
 
@@ -1253,6 +1677,50 @@ begin
 
 
 
+	------------------------- Floppy Disk Controller -------------------------
+
+	wo_fdc : if not p_enable_floppy generate
+		s_is_syscon_fdc_port <= '0';
+		s_syscon_fdc_cpu_din <= (others => '0');
+		s_fdc_dout_cpu <= x"FF";
+		s_fdc_cpu_int <= '0';
+		s_irqs(6) <= '0';
+	end generate;
+
+	w_fdc : if p_enable_floppy generate
+
+		s_is_syscon_fdc_port <= s_hijacked when s_cpu_addr(7 downto 3) = "11010" else '0';
+		s_syscon_fdc_port_wr_rising_edge <= s_is_syscon_fdc_port and s_port_wr_rising_edge;
+		s_syscon_fdc_port_rd_falling_edge <= s_is_syscon_fdc_port and s_port_rd_falling_edge;
+		s_fdc_mem_wr_rising_edge <= s_is_fdc_range and s_mem_wr_rising_edge;
+		s_fdc_mem_rd_falling_edge <= s_is_fdc_range and s_mem_rd_falling_edge;
+
+		fdc : entity work.Trs80FloppyController
+		generic map
+		(
+			p_clock_hz => 80_000_000
+		)
+		port map
+		(
+			i_clock => i_clock_80mhz,
+			i_reset => s_reset,
+			i_cpu_addr => s_cpu_addr(3 downto 0),
+			i_cpu_mem_wr_rising_edge => s_fdc_mem_wr_rising_edge,
+			i_cpu_mem_rd_falling_edge => s_fdc_mem_rd_falling_edge,
+			o_cpu_din => s_fdc_dout_cpu,
+			i_cpu_dout => s_cpu_dout,
+			i_syscon_port_number => s_cpu_addr(2 downto 0),
+			i_syscon_port_wr_rising_edge => s_syscon_fdc_port_wr_rising_edge,
+			i_syscon_port_rd_falling_edge => s_syscon_fdc_port_rd_falling_edge,
+			o_syscon_din => s_syscon_fdc_cpu_din,
+			o_syscon_irq => s_irqs(6),
+			o_cpu_int => s_fdc_cpu_int
+		);
+
+	end generate;
+
+
+
 	------------------------- SysCon Video Controller -------------------------
 
 
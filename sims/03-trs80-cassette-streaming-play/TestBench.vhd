@@ -66,6 +66,8 @@ begin
         o_audio => s_audio,
         i_audio => '0',
         o_block_available => open,
+        i_fast_data_cycle => '0',
+        i_fast_data => x"00",
         o_data => open,
         i_stop_recording => '0',
         o_recording_finished => open
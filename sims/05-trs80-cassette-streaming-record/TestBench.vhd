@@ -77,6 +77,8 @@ begin
         o_audio => open,
         i_audio => s_audio(0),
         o_block_available => s_sd_block_available,
+        i_fast_data_cycle => '0',
+        i_fast_data => x"00",
         i_data_cycle => s_sd_data_cycle,
         o_data => s_sd_data,
         i_stop_recording => s_stop_recording,
@@ -44,6 +44,7 @@ begin
         i_reset => s_reset,
         i_motor => s_motor,
         i_audio => s_audio,
+        i_data_cycle => '0',
         o_start => s_start,
         o_record => s_record,
         o_stop => s_stop
@@ -0,0 +1,388 @@
+--------------------------------------------------------------------------
+--
+-- Cassette file round trip test bench
+--
+-- Reads a real .cas file and feeds it through the cassette playback
+-- pipeline (Trs80CassetteStreamer or Trs80CassetteFifo -> audio ->
+-- Trs80CassetteParser) and asserts the parsed bytes exactly match the
+-- file.  Runs four pipelines side by side:
+--
+--   * streamer at the normal 1.774Mhz clock enable
+--   * streamer at the 40Mhz turbo clock enable
+--   * fifo at the normal 1.774Mhz clock enable
+--   * fifo at the 40Mhz turbo clock enable
+--
+-- Each pipeline services data requests after a fixed delay (simulating
+-- the syscon firmware's latency) and reports the shortest interval seen
+-- between requests.  That's the budget the syscon has to serve a block.
+--
+-- The simulation stops by itself once all pipelines have finished.  Use
+-- -gp_cas_file=<file> to test a different tape.
+--
+--------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.ALL;
+
+entity CassettePipeline is
+generic
+(
+    p_name : string;
+    p_cas_file : string;
+    p_clock_hz : real;                              -- Main clock (clken is half this)
+    p_use_fifo : boolean;                           -- Trs80CassetteFifo instead of Trs80CassetteStreamer
+    p_buffer_size : integer;                        -- Half buffer size as power of 2
+    p_service_delay : time                          -- Latency before serving each request
+);
+port
+(
+    o_done : out std_logic
+);
+end CassettePipeline;
+
+architecture behavior of CassettePipeline is
+    type char_file is file of character;
+
+    signal s_clock : std_logic := '0';
+    signal s_reset : std_logic;
+    signal s_clken : std_logic;
+    signal s_done : std_logic := '0';
+
+    signal s_audio : std_logic_vector(1 downto 0);
+    signal s_din : std_logic_vector(7 downto 0);
+    signal s_data_cycle : std_logic;
+    signal s_strobe : std_logic;
+    signal s_block_needed : std_logic;
+    signal s_data_irq : std_logic;
+    signal s_full : std_logic;
+    signal s_play : std_logic;
+    signal s_request : std_logic;
+
+    signal s_dout : std_logic_vector(7 downto 0);
+    signal s_dout_available : std_logic;
+
+    constant c_quantum : integer := 2 ** p_buffer_size;
+begin
+
+    o_done <= s_done;
+
+    reset_proc: process
+    begin
+        s_reset <= '1';
+        wait until rising_edge(s_clock);
+        wait until falling_edge(s_clock);
+        s_reset <= '0';
+        wait;
+    end process;
+
+    stim_proc: process
+    begin
+        if s_done = '1' then
+            wait;
+        end if;
+        s_clock <= not s_clock;
+        wait for 1 sec / (p_clock_hz * 2.0);
+    end process;
+
+    clken_proc : process(s_clock)
+    begin
+        if rising_edge(s_clock) then
+            if s_reset = '1' then
+                s_clken <= '0';
+            else
+                s_clken <= not s_clken;
+            end if;
+        end if;
+    end process;
+
+    -- Data is presented with s_strobe and consumed on a clock enabled cycle
+    s_data_cycle <= s_strobe and s_clken;
+
+    with_streamer : if not p_use_fifo generate
+
+        streamer : entity work.Trs80CassetteStreamer
+        generic map
+        (
+            p_clken_hz => 1_774_000,
+            p_buffer_size => p_buffer_size
+        )
+        port map
+        (
+            i_clock => s_clock,
+            i_clken => s_clken,
+            i_reset => s_reset,
+            i_record_mode => '0',
+            i_data => s_din,
+            i_data_cycle => s_data_cycle,
+            o_block_needed => s_block_needed,
+            o_audio => s_audio,
+            i_audio => '0',
+            o_block_available => open,
+            i_fast_data_cycle => '0',
+            i_fast_data => x"00",
+            o_data => open,
+            i_stop_recording => '0',
+            o_recording_finished => open
+        );
+
+        s_request <= s_block_needed;
+        s_full <= '0';
+
+    end generate;
+
+    with_fifo : if p_use_fifo generate
+
+        fifo : entity work.Trs80CassetteFifo
+        generic map
+        (
+            p_clken_hz => 1_774_000,
+            p_buffer_size => p_buffer_size + 1
+        )
+        port map
+        (
+            i_clock => s_clock,
+            i_clken => s_clken,
+            i_reset => s_reset,
+            i_play => s_play,
+            i_record => '0',
+            o_audio => s_audio,
+            i_audio => '0',
+            i_din => s_din,
+            o_dout => open,
+            i_data_cycle => s_data_cycle,
+            o_data_irq => s_data_irq,
+            o_full => s_full,
+            o_empty => open
+        );
+
+        s_request <= s_data_irq;
+
+    end generate;
+
+    parser : entity work.Trs80CassetteParser
+    generic map
+    (
+        p_clken_hz => 1_774_000
+    )
+    port map
+    (
+        i_clock => s_clock,
+        i_clken => s_clken,
+        i_reset => s_reset,
+        i_audio => s_audio(0),
+        o_data => s_dout,
+        o_data_available => s_dout_available
+    );
+
+    -- Serve data requests from the file (zero padded after end of file)
+    feeder : process(s_clock)
+        file f : char_file open read_mode is p_cas_file;
+        variable c : character;
+        variable v_state : integer := 0;           -- 0 = prefill, 1 = idle, 2 = delay, 3 = feeding
+        variable v_remaining : integer;
+        variable v_delay_until : time;
+        variable v_last_request : time := 0 ns;
+        variable v_min_interval : time := 1000 sec;
+        variable v_requests : integer := 0;
+    begin
+        if rising_edge(s_clock) then
+            if s_reset = '1' then
+                s_strobe <= '0';
+                s_din <= (others => '0');
+                if p_use_fifo then
+                    s_play <= '0';
+                    v_state := 0;
+                else
+                    s_play <= '1';
+                    v_state := 1;
+                end if;
+            elsif s_done = '1' then
+                if v_requests > 1 then
+                    report p_name & ": shortest interval between requests " & time'image(v_min_interval) &
+                        " (" & integer'image(c_quantum) & " bytes per request, " &
+                        time'image(v_min_interval * 512 / c_quantum) & " per 512 byte block)";
+                    v_requests := 0;
+                end if;
+            else
+
+                -- Strobe consumed?
+                if s_strobe = '1' and s_clken = '1' then
+                    s_strobe <= '0';
+                end if;
+
+                case v_state is
+
+                    when 1 =>
+                        if s_request = '1' then
+                            if v_requests > 0 and now - v_last_request < v_min_interval then
+                                v_min_interval := now - v_last_request;
+                            end if;
+                            v_last_request := now;
+                            v_requests := v_requests + 1;
+                            v_delay_until := now + p_service_delay;
+                            v_state := 2;
+                        end if;
+
+                    when 2 =>
+                        if now >= v_delay_until then
+                            v_remaining := c_quantum;
+                            v_state := 3;
+                        end if;
+
+                    when others =>
+                        -- Feed the next byte once the previous one has been consumed
+                        if s_strobe = '0' or (s_strobe = '1' and s_clken = '1') then
+                            if (p_use_fifo and s_full = '1') or (not p_use_fifo and v_remaining = 0) then
+                                s_play <= '1';
+                                v_state := 1;
+                            elsif s_strobe = '0' then
+                                if endfile(f) then
+                                    s_din <= (others => '0');
+                                else
+                                    read(f, c);
+                                    s_din <= std_logic_vector(to_unsigned(character'pos(c), 8));
+                                end if;
+                                s_strobe <= '1';
+                                v_remaining := v_remaining - 1;
+                            end if;
+                        end if;
+
+                end case;
+            end if;
+        end if;
+    end process;
+
+    -- Check the parsed bytes match the file (starting at the first
+    -- non-zero byte, which is where the parser syncs)
+    checker : process(s_clock)
+        file f : char_file open read_mode is p_cas_file;
+        variable c : character;
+        variable v_expected : integer;
+        variable v_synced : boolean := false;
+        variable v_count : integer := 0;
+        variable v_errors : integer := 0;
+    begin
+        if rising_edge(s_clock) then
+            if s_reset = '0' and s_done = '0' and s_dout_available = '1' and s_clken = '1' then
+
+                -- Skip the leader
+                if not v_synced then
+                    loop
+                        read(f, c);
+                        exit when character'pos(c) /= 0;
+                    end loop;
+                    v_expected := character'pos(c);
+                    v_synced := true;
+                    assert v_expected >= 128
+                        report p_name & ": first byte after leader doesn't start with a 1 bit" severity warning;
+                end if;
+
+                assert to_integer(unsigned(s_dout)) = v_expected
+                    report p_name & ": byte " & integer'image(v_count) & " expected " & integer'image(v_expected) &
+                        " got " & integer'image(to_integer(unsigned(s_dout))) severity error;
+                if to_integer(unsigned(s_dout)) /= v_expected then
+                    v_errors := v_errors + 1;
+                end if;
+                v_count := v_count + 1;
+
+                if endfile(f) then
+                    report p_name & ": " & integer'image(v_count) & " bytes checked, " & integer'image(v_errors) & " errors";
+                    assert v_errors = 0 report p_name & ": FAILED" severity failure;
+                    s_done <= '1';
+                else
+                    read(f, c);
+                    v_expected := character'pos(c);
+                end if;
+
+            end if;
+        end if;
+    end process;
+
+end;
+
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.ALL;
+
+entity TestBench is
+generic
+(
+    p_cas_file : string := "test.cas"
+);
+end TestBench;
+
+architecture behavior of TestBench is
+    signal s_done : std_logic_vector(3 downto 0);
+begin
+
+    streamer_normal : entity work.CassettePipeline
+    generic map
+    (
+        p_name => "streamer 1.774Mhz",
+        p_cas_file => p_cas_file,
+        p_clock_hz => 1_774_000.0 * 2.0,
+        p_use_fifo => false,
+        p_buffer_size => 6,
+        p_service_delay => 100 ms
+    )
+    port map
+    (
+        o_done => s_done(0)
+    );
+
+    streamer_turbo : entity work.CassettePipeline
+    generic map
+    (
+        p_name => "streamer 40Mhz",
+        p_cas_file => p_cas_file,
+        p_clock_hz => 80_000_000.0,
+        p_use_fifo => false,
+        p_buffer_size => 6,
+        p_service_delay => 5 ms
+    )
+    port map
+    (
+        o_done => s_done(1)
+    );
+
+    fifo_normal : entity work.CassettePipeline
+    generic map
+    (
+        p_name => "fifo 1.774Mhz",
+        p_cas_file => p_cas_file,
+        p_clock_hz => 1_774_000.0 * 2.0,
+        p_use_fifo => true,
+        p_buffer_size => 6,
+        p_service_delay => 100 ms
+    )
+    port map
+    (
+        o_done => s_done(2)
+    );
+
+    fifo_turbo : entity work.CassettePipeline
+    generic map
+    (
+        p_name => "fifo 40Mhz",
+        p_cas_file => p_cas_file,
+        p_clock_hz => 80_000_000.0,
+        p_use_fifo => true,
+        p_buffer_size => 6,
+        p_service_delay => 5 ms
+    )
+    port map
+    (
+        o_done => s_done(3)
+    );
+
+    done_proc : process
+    begin
+        wait until s_done = "1111";
+        report "All cassette round trips passed";
+        wait;
+    end process;
+
+end;
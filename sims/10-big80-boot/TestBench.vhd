@@ -0,0 +1,621 @@
+--------------------------------------------------------------------------
+--
+-- Full system boot test bench
+--
+-- Runs the complete Trs80Model1Core (as wired up by the 99-big80-lpddr
+-- board) from reset:
+--
+--   bootrom -> big80.sys from SD card -> level2-a.rom from SD card
+--           -> TRS-80 reset -> BASIC waiting for input
+--
+-- The board's LPDDR controller and clocking are Xilinx primitives that
+-- can't be simulated with GHDL, so the core is connected directly to:
+--
+--   * SimRam - behavioral model of the 256K RAM behind SimpleRamInterface
+--     with a configurable read/write latency
+--   * SimSDCard - behavioral SPI mode SD card backed by an image file
+--     (see the makefile for how the image is built)
+--
+-- The simulation stops by itself once the TRS-80 is sitting in the ROM's
+-- wait-for-key loop (ie: the "MEMORY SIZE?" prompt) and reports the
+-- simulated boot time and SD card traffic.  Use -gp_image_file=<file> to
+-- boot a different image and -gp_ram_latency=<cycles> to see the effect
+-- of slower memory.
+--
+-- The CRCs the bootrom and syscon write into the load stamps (see
+-- syscon/loadstamp.h) are checked against -gp_syscon_crc=<hex> and
+-- -gp_level2_crc=<hex>, which the makefile computes on the host.
+--
+--------------------------------------------------------------------------
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.ALL;
+
+entity SimRam is
+generic
+(
+    p_latency : integer                             -- Clock cycles per read/write
+);
+port
+(
+    i_clock : in std_logic;
+    i_rd : in std_logic;
+    i_wr : in std_logic;
+    i_addr : in std_logic_vector(17 downto 0);
+    i_data : in std_logic_vector(7 downto 0);
+    o_data : out std_logic_vector(7 downto 0);
+    o_wait : out std_logic
+);
+end SimRam;
+
+architecture behavior of SimRam is
+    signal s_busy : std_logic := '0';
+begin
+
+    -- Wait is asserted from the cycle the operation is requested until
+    -- the operation completes (same as SimpleRamInterface)
+    o_wait <= i_rd or i_wr or s_busy;
+
+    process(i_clock)
+        type mem_type is array(0 to 2**18-1) of integer range 0 to 255;
+        variable mem : mem_type := (others => 0);
+        variable v_count : integer := 0;
+        variable v_addr : integer;
+        variable v_write : boolean;
+        variable v_data : integer;
+    begin
+        if rising_edge(i_clock) then
+            if i_rd = '1' or i_wr = '1' then
+                v_addr := to_integer(unsigned(i_addr));
+                v_write := i_wr = '1';
+                v_data := to_integer(unsigned(i_data));
+                v_count := p_latency;
+                s_busy <= '1';
+            elsif v_count > 0 then
+                v_count := v_count - 1;
+                if v_count = 0 then
+                    if v_write then
+                        mem(v_addr) := v_data;
+                    else
+                        o_data <= std_logic_vector(to_unsigned(mem(v_addr), 8));
+                    end if;
+                    s_busy <= '0';
+                end if;
+            end if;
+        end if;
+    end process;
+
+end;
+
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.ALL;
+
+entity SimSDCard is
+generic
+(
+    p_image_file : string;
+    p_image_sectors : integer;                      -- Capacity (image file can be smaller)
+    p_sdhc : boolean;                               -- Block (vs byte) addressing
+    p_read_latency : integer                        -- Bytes clocked before a read's data token
+);
+port
+(
+    i_ss_n : in std_logic;
+    i_sclk : in std_logic;
+    i_mosi : in std_logic;
+    o_miso : out std_logic;
+
+    o_initialized : out std_logic;
+    o_sectors_read : out integer;
+    o_sectors_written : out integer
+);
+end SimSDCard;
+
+architecture behavior of SimSDCard is
+begin
+
+    -- SPI mode 0: MOSI is sampled on the rising edge of the clock, MISO
+    -- changes on the falling edge.  Everything's handled a byte at a time
+    -- with responses queued up to be clocked out.
+    process(i_ss_n, i_sclk)
+        type char_file is file of character;
+        type image_type is array(natural range <>) of character;
+        type image_ptr is access image_type;
+        type queue_type is array(0 to 1023) of integer range 0 to 255;
+
+        file f : char_file open read_mode is p_image_file;
+        variable c : character;
+        variable img : image_ptr := null;
+
+        variable v_rx : std_logic_vector(7 downto 0);
+        variable v_rx_bits : integer := 0;
+        variable v_tx : std_logic_vector(7 downto 0) := x"FF";
+        variable v_tx_bit : integer := 6;
+
+        variable queue : queue_type;
+        variable v_queue_head : integer := 0;
+        variable v_queue_count : integer := 0;
+
+        variable cmd : queue_type;
+        variable v_cmd_len : integer := 0;
+        variable v_arg : unsigned(31 downto 0);
+
+        variable v_idle : boolean := true;
+        variable v_app_cmd : boolean := false;
+        variable v_init_polls : integer := 0;
+
+        variable v_write_state : integer := 0;      -- 0 = none, 1 = wait token, 2 = receiving data
+        variable v_write_pos : integer;
+        variable v_write_count : integer;
+        variable v_sector : integer;
+
+        variable v_sectors_read : integer := 0;
+        variable v_sectors_written : integer := 0;
+
+        procedure enqueue(value : integer) is
+        begin
+            assert v_queue_count < queue'length report "SD response queue overflow" severity failure;
+            queue((v_queue_head + v_queue_count) mod queue'length) := value;
+            v_queue_count := v_queue_count + 1;
+        end procedure;
+
+        impure function dequeue return integer is
+            variable value : integer;
+        begin
+            if v_queue_count = 0 then
+                return 16#FF#;
+            end if;
+            value := queue(v_queue_head);
+            v_queue_head := (v_queue_head + 1) mod queue'length;
+            v_queue_count := v_queue_count - 1;
+            return value;
+        end function;
+
+        impure function r1 return integer is
+        begin
+            if v_idle then
+                return 16#01#;
+            else
+                return 16#00#;
+            end if;
+        end function;
+
+        -- Map a command argument to a sector number
+        impure function arg_sector return integer is
+        begin
+            if p_sdhc then
+                return to_integer(v_arg);
+            else
+                return to_integer(v_arg(31 downto 9));
+            end if;
+        end function;
+
+        procedure execute_command is
+            variable v_index : integer;
+        begin
+            v_index := cmd(0) mod 64;
+            v_arg := to_unsigned(cmd(1), 8) & to_unsigned(cmd(2), 8) & to_unsigned(cmd(3), 8) & to_unsigned(cmd(4), 8);
+
+            -- NCR
+            enqueue(16#FF#);
+
+            if v_app_cmd then
+                v_app_cmd := false;
+                if v_index = 41 then
+                    -- ACMD41 - report busy the first time, then ready
+                    v_init_polls := v_init_polls + 1;
+                    if v_init_polls > 1 then
+                        v_idle := false;
+                        o_initialized <= '1';
+                    end if;
+                    enqueue(r1);
+                    return;
+                end if;
+            end if;
+
+            case v_index is
+
+                when 0 =>
+                    -- GO_IDLE_STATE
+                    v_idle := true;
+                    v_init_polls := 0;
+                    enqueue(r1);
+
+                when 8 =>
+                    -- SEND_IF_COND (echo voltage and check pattern)
+                    enqueue(r1);
+                    enqueue(16#00#);
+                    enqueue(16#00#);
+                    enqueue(cmd(3));
+                    enqueue(cmd(4));
+
+                when 55 =>
+                    -- APP_CMD
+                    v_app_cmd := true;
+                    enqueue(r1);
+
+                when 58 =>
+                    -- READ_OCR (powered up, CCS)
+                    enqueue(r1);
+                    if p_sdhc then
+                        enqueue(16#C0#);
+                    else
+                        enqueue(16#80#);
+                    end if;
+                    enqueue(16#FF#);
+                    enqueue(16#80#);
+                    enqueue(16#00#);
+
+                when 16 | 59 =>
+                    -- SET_BLOCKLEN, CRC_ON_OFF
+                    enqueue(r1);
+
+                when 17 =>
+                    -- READ_SINGLE_BLOCK
+                    v_sector := arg_sector;
+                    assert v_sector < p_image_sectors report "SD read past end of card" severity failure;
+                    enqueue(r1);
+                    for i in 1 to p_read_latency loop
+                        enqueue(16#FF#);
+                    end loop;
+                    enqueue(16#FE#);
+                    for i in 0 to 511 loop
+                        enqueue(character'pos(img(v_sector * 512 + i)));
+                    end loop;
+                    enqueue(16#FF#);
+                    enqueue(16#FF#);
+                    v_sectors_read := v_sectors_read + 1;
+                    o_sectors_read <= v_sectors_read;
+
+                when 24 =>
+                    -- WRITE_BLOCK
+                    v_sector := arg_sector;
+                    assert v_sector < p_image_sectors report "SD write past end of card" severity failure;
+                    enqueue(r1);
+                    v_write_state := 1;
+
+                when others =>
+                    report "SD command " & integer'image(v_index) & " not supported" severity warning;
+                    enqueue(r1 + 16#04#);
+
+            end case;
+        end procedure;
+
+        procedure receive_byte(value : integer) is
+        begin
+            case v_write_state is
+
+                when 1 =>
+                    -- Waiting for start block token
+                    if value = 16#FE# then
+                        v_write_pos := v_sector * 512;
+                        v_write_count := 0;
+                        v_write_state := 2;
+                    end if;
+
+                when 2 =>
+                    -- Data block followed by 2 CRC bytes
+                    if v_write_count < 512 then
+                        img(v_write_pos + v_write_count) := character'val(value);
+                    end if;
+                    v_write_count := v_write_count + 1;
+                    if v_write_count = 514 then
+                        -- Data accepted, then busy for a few bytes
+                        enqueue(16#E5#);
+                        for i in 1 to 4 loop
+                            enqueue(16#00#);
+                        end loop;
+                        v_write_state := 0;
+                        v_sectors_written := v_sectors_written + 1;
+                        o_sectors_written <= v_sectors_written;
+                    end if;
+
+                when others =>
+                    -- Command bytes start with 01xxxxxx
+                    if v_cmd_len = 0 and value / 64 /= 1 then
+                        return;
+                    end if;
+                    cmd(v_cmd_len) := value;
+                    v_cmd_len := v_cmd_len + 1;
+                    if v_cmd_len = 6 then
+                        v_cmd_len := 0;
+                        execute_command;
+                    end if;
+
+            end case;
+        end procedure;
+
+    begin
+
+        -- Load the image first time through
+        if img = null then
+            img := new image_type(0 to p_image_sectors * 512 - 1);
+            for i in img'range loop
+                exit when endfile(f);
+                read(f, c);
+                img(i) := c;
+            end loop;
+            o_miso <= '1';
+            o_initialized <= '0';
+            o_sectors_read <= 0;
+            o_sectors_written <= 0;
+        end if;
+
+        if i_ss_n = '1' then
+            -- Deselected, start a new byte next time
+            v_rx_bits := 0;
+            v_tx := x"FF";
+            v_tx_bit := 6;
+            o_miso <= '1';
+        elsif rising_edge(i_sclk) then
+            v_rx := v_rx(6 downto 0) & i_mosi;
+            v_rx_bits := v_rx_bits + 1;
+            if v_rx_bits = 8 then
+                v_rx_bits := 0;
+                receive_byte(to_integer(unsigned(v_rx)));
+            end if;
+        elsif falling_edge(i_sclk) then
+            if v_rx_bits = 0 then
+                v_tx := std_logic_vector(to_unsigned(dequeue, 8));
+                o_miso <= v_tx(7);
+                v_tx_bit := 6;
+            elsif v_tx_bit >= 0 then
+                o_miso <= v_tx(v_tx_bit);
+                v_tx_bit := v_tx_bit - 1;
+            end if;
+        end if;
+    end process;
+
+end;
+
+
+
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.ALL;
+
+entity TestBench is
+generic
+(
+    p_image_file : string := "sd.img";
+    p_image_sectors : integer := 16384;
+    p_ram_latency : integer := 12;
+    p_timeout : time := 60 sec;
+    p_syscon_crc : string := "";                    -- Expected load stamp CRCs (hex, empty to skip)
+    p_level2_crc : string := ""
+);
+end TestBench;
+
+architecture behavior of TestBench is
+    function hex_to_slv(s : string) return std_logic_vector is
+        variable v : unsigned(31 downto 0) := (others => '0');
+        variable d : integer;
+    begin
+        for i in s'range loop
+            case s(i) is
+                when '0' to '9' => d := character'pos(s(i)) - character'pos('0');
+                when 'a' to 'f' => d := character'pos(s(i)) - character'pos('a') + 10;
+                when 'A' to 'F' => d := character'pos(s(i)) - character'pos('A') + 10;
+                when others => report "Bad hex digit in " & s severity failure;
+            end case;
+            v := v(27 downto 0) & to_unsigned(d, 4);
+        end loop;
+        return std_logic_vector(v);
+    end function;
+
+    function slv_to_hex(v : std_logic_vector(31 downto 0)) return string is
+        constant digits : string(1 to 16) := "0123456789ABCDEF";
+        variable s : string(1 to 8);
+    begin
+        for i in 0 to 7 loop
+            s(8 - i) := digits(to_integer(unsigned(v(i * 4 + 3 downto i * 4))) + 1);
+        end loop;
+        return s;
+    end function;
+
+    type crc_array is array(0 to 1) of std_logic_vector(31 downto 0);
+
+    signal s_clock : std_logic := '0';
+    signal s_reset : std_logic;
+    signal s_done : std_logic := '0';
+
+    signal s_ram_rd : std_logic;
+    signal s_ram_wr : std_logic;
+    signal s_ram_din : std_logic_vector(7 downto 0);
+    signal s_ram_dout : std_logic_vector(7 downto 0);
+    signal s_ram_wait : std_logic;
+    signal s_ram_addr : std_logic_vector(17 downto 0);
+
+    signal s_sd_mosi : std_logic;
+    signal s_sd_miso : std_logic;
+    signal s_sd_ss_n : std_logic;
+    signal s_sd_sclk : std_logic;
+    signal s_sd_initialized : std_logic;
+    signal s_sd_sectors_read : integer;
+    signal s_sd_sectors_written : integer;
+
+    signal s_ps2_clock : std_logic := 'H';
+    signal s_ps2_data : std_logic := 'H';
+
+    signal s_stamp_crc : crc_array := (others => (others => '0'));
+begin
+
+    reset_proc: process
+    begin
+        s_reset <= '1';
+        wait for 100 ns;
+        wait until falling_edge(s_clock);
+        s_reset <= '0';
+        wait;
+    end process;
+
+    -- 80Mhz
+    stim_proc: process
+    begin
+        if s_done = '1' then
+            wait;
+        end if;
+        s_clock <= not s_clock;
+        wait for 6.25 ns;
+    end process;
+
+    ram : entity work.SimRam
+    generic map
+    (
+        p_latency => p_ram_latency
+    )
+    port map
+    (
+        i_clock => s_clock,
+        i_rd => s_ram_rd,
+        i_wr => s_ram_wr,
+        i_addr => s_ram_addr,
+        i_data => s_ram_din,
+        o_data => s_ram_dout,
+        o_wait => s_ram_wait
+    );
+
+    sdcard : entity work.SimSDCard
+    generic map
+    (
+        p_image_file => p_image_file,
+        p_image_sectors => p_image_sectors,
+        p_sdhc => true,
+        p_read_latency => 8
+    )
+    port map
+    (
+        i_ss_n => s_sd_ss_n,
+        i_sclk => s_sd_sclk,
+        i_mosi => s_sd_mosi,
+        o_miso => s_sd_miso,
+        o_initialized => s_sd_initialized,
+        o_sectors_read => s_sd_sectors_read,
+        o_sectors_written => s_sd_sectors_written
+    );
+
+    trs80 : entity work.Trs80Model1Core
+    generic map
+    (
+        p_enable_video_controller => true,
+        p_enable_keyboard => true,
+        p_enable_cassette_player => true,
+        p_enable_trisstick => true
+    )
+    port map
+    (
+        o_debug => open,
+        o_uart_debug => open,
+        i_clock_80mhz => s_clock,
+        i_reset => s_reset,
+        o_clken_cpu => open,
+        i_switch_run => '1',
+        o_status => open,
+        o_ram_cs => open,
+        o_ram_addr => s_ram_addr,
+        o_ram_din => s_ram_din,
+        i_ram_dout => s_ram_dout,
+        o_ram_rd => s_ram_rd,
+        o_ram_wr => s_ram_wr,
+        i_ram_wait => s_ram_wait,
+        o_horz_sync => open,
+        o_vert_sync => open,
+        o_red => open,
+        o_green => open,
+        o_blue => open,
+        io_ps2_clock => s_ps2_clock,
+        io_ps2_data => s_ps2_data,
+        o_audio => open,
+        o_uart_tx => open,
+        i_uart_rx => '1',
+        o_uart_rts_n => open,
+        o_sd_mosi => s_sd_mosi,
+        i_sd_miso => s_sd_miso,
+        o_sd_ss_n => s_sd_ss_n,
+        o_sd_sclk => s_sd_sclk,
+        o_psx_att => open,
+        o_psx_clock => open,
+        o_psx_hoci => open,
+        i_psx_hico => '1',
+        i_psx_ack => '1'
+    );
+
+    -- Report boot milestones
+    milestone_proc : process
+    begin
+        wait until s_sd_initialized = '1';
+        report "SD card initialized at " & time'image(now);
+        wait;
+    end process;
+
+    -- The ROM polls the keyboard from its wait-for-key loop at 0049h.
+    -- The syscon reads that address once when it checksums the ROM
+    -- image, so wait until it's been fetched many times.
+    prompt_proc : process(s_clock)
+        variable v_polls : integer := 0;
+    begin
+        if rising_edge(s_clock) then
+            if s_reset = '0' and s_done = '0' and s_ram_rd = '1' and s_ram_addr = "00" & x"0049" then
+                v_polls := v_polls + 1;
+                if v_polls = 100 then
+                    report "BASIC prompt reached at " & time'image(now) &
+                        " (" & integer'image(s_sd_sectors_read) & " sectors read, " &
+                        integer'image(s_sd_sectors_written) & " written)";
+                    s_done <= '1';
+                end if;
+            end if;
+        end if;
+    end process;
+
+    -- Capture the CRCs written into the load stamps in bank 255.  Each
+    -- stamp is 32 bytes with the CRC (little endian) at offset 12.  Slot
+    -- 0 is big80.sys (written by the bootrom), slot 1 is level2-a.rom
+    -- (written by the syscon).
+    stamp_proc : process(s_clock)
+        variable v_offset : integer;
+        variable v_slot : integer;
+        variable v_byte : integer;
+    begin
+        if rising_edge(s_clock) then
+            if s_ram_wr = '1' and s_ram_addr(17 downto 10) = x"FF" then
+                v_offset := to_integer(unsigned(s_ram_addr(9 downto 0)));
+                v_slot := v_offset / 32;
+                v_byte := v_offset mod 32 - 12;
+                if v_slot <= 1 and v_byte >= 0 and v_byte <= 3 then
+                    s_stamp_crc(v_slot)(v_byte * 8 + 7 downto v_byte * 8) <= s_ram_din;
+                end if;
+            end if;
+        end if;
+    end process;
+
+    stamp_check_proc : process
+        procedure check(name : string; slot : integer; expected : string) is
+        begin
+            if expected'length = 0 then
+                return;
+            end if;
+            assert s_stamp_crc(slot) = hex_to_slv(expected)
+                report name & " load stamp CRC is " & slv_to_hex(s_stamp_crc(slot)) &
+                    ", expected " & expected
+                severity failure;
+            report name & " load stamp CRC " & slv_to_hex(s_stamp_crc(slot)) & " OK";
+        end procedure;
+    begin
+        wait until s_done = '1';
+        check("big80.sys", 0, p_syscon_crc);
+        check("level2-a.rom", 1, p_level2_crc);
+        wait;
+    end process;
+
+    timeout_proc : process
+    begin
+        wait until s_done = '1' for p_timeout;
+        assert s_done = '1' report "Timed out waiting for BASIC prompt" severity failure;
+        wait;
+    end process;
+
+end;
@@ -0,0 +1,182 @@
+#include "syscon.h"
+
+// Allocator for the spare external RAM banks (128 -> 254, bank 255 holds
+// the load stamps).  These banks aren't visible to either the TRS-80 or
+// the syscon address space and can only be accessed by mapping them into
+// banked_page (0xFC00) via ApmPageBank.
+
+static uint8_t g_bankBitmap[(BANK_LAST_SPARE - BANK_FIRST_SPARE + 8) / 8];
+
+static bool is_bank_used(uint8_t bank)
+{
+    bank -= BANK_FIRST_SPARE;
+    return (g_bankBitmap[bank >> 3] & (1 << (bank & 7))) != 0;
+}
+
+static void set_bank_used(uint8_t bank, bool used)
+{
+    bank -= BANK_FIRST_SPARE;
+    if (used)
+        g_bankBitmap[bank >> 3] |= (1 << (bank & 7));
+    else
+        g_bankBitmap[bank >> 3] &= ~(1 << (bank & 7));
+}
+
+// Allocate a contiguous run of banks, returns the first bank or 0 if
+// there's not enough free space
+uint8_t bank_alloc(uint8_t count)
+{
+    uint8_t runStart = BANK_FIRST_SPARE;
+    uint8_t runLength = 0;
+    uint16_t bank;
+    for (bank = BANK_FIRST_SPARE; bank <= BANK_LAST_SPARE; bank++)
+    {
+        if (is_bank_used(bank))
+        {
+            runStart = bank + 1;
+            runLength = 0;
+            continue;
+        }
+
+        runLength++;
+        if (runLength == count)
+        {
+            for (bank = runStart; bank < runStart + count; bank++)
+                set_bank_used(bank, true);
+            return runStart;
+        }
+    }
+    return 0;
+}
+
+// Release banks previously allocated with bank_alloc
+void bank_free(uint8_t bank, uint8_t count)
+{
+    while (count--)
+        set_bank_used(bank++, false);
+}
+
+// Get the number of unallocated banks
+uint8_t bank_free_count()
+{
+    uint8_t count = 0;
+    uint16_t bank;
+    for (bank = BANK_FIRST_SPARE; bank <= BANK_LAST_SPARE; bank++)
+    {
+        if (!is_bank_used(bank))
+            count++;
+    }
+    return count;
+}
+
+// Map a bank into banked_page, returning the previous mapping state
+// which should be passed to bank_unmap.  The syscon video bank shares
+// the same address range so it's disabled while a bank is mapped.
+uint16_t bank_map(uint8_t bank)
+{
+    uint16_t save = (ApmPageBank << 8) | ApmEnable;
+    ApmPageBank = bank;
+    ApmEnable = (ApmEnable & ~APM_ENABLE_VIDEOBANK) | APM_ENABLE_PAGEBANK;
+    return save;
+}
+
+// Restore mapping state saved by bank_map
+void bank_unmap(uint16_t save)
+{
+    ApmPageBank = save >> 8;
+    ApmEnable = save & 0xFF;
+}
+
+// Copy from banked memory, starting at offset from the start of bank
+void bank_read(uint8_t bank, uint16_t offset, void* dst, uint16_t length)
+{
+    uint8_t* p = (uint8_t*)dst;
+    bank += offset >> 10;
+    offset &= 0x3FF;
+
+    uint16_t save = bank_map(bank);
+    while (length)
+    {
+        uint16_t chunk = sizeof(banked_page) - offset;
+        if (chunk > length)
+            chunk = length;
+
+        ApmPageBank = bank;
+        memcpy(p, banked_page + offset, chunk);
+
+        p += chunk;
+        length -= chunk;
+        offset = 0;
+        bank++;
+    }
+    bank_unmap(save);
+}
+
+// Copy to banked memory, starting at offset from the start of bank
+void bank_write(uint8_t bank, uint16_t offset, const void* src, uint16_t length)
+{
+    const uint8_t* p = (const uint8_t*)src;
+    bank += offset >> 10;
+    offset &= 0x3FF;
+
+    uint16_t save = bank_map(bank);
+    while (length)
+    {
+        uint16_t chunk = sizeof(banked_page) - offset;
+        if (chunk > length)
+            chunk = length;
+
+        ApmPageBank = bank;
+        memcpy(banked_page + offset, p, chunk);
+
+        p += chunk;
+        length -= chunk;
+        offset = 0;
+        bank++;
+    }
+    bank_unmap(save);
+}
+
+// Check if an image loaded into banked memory is still resident and
+// matches the file on the SD card (see load stamps in syscon.h)
+bool bank_is_resident(uint8_t slot, uint8_t firstBank, FILINFO* pfi)
+{
+    LOADSTAMP stamp;
+    bank_read(BANK_STAMPS, slot * sizeof(LOADSTAMP), &stamp, sizeof(LOADSTAMP));
+
+    if (stamp.signature != STAMP_SIGNATURE ||
+        stamp.firstBank != firstBank ||
+        stamp.size != pfi->fsize ||
+        stamp.fdate != pfi->fdate ||
+        stamp.ftime != pfi->ftime)
+        return false;
+
+    // Verify the resident copy
+    uint32_t crc = 0;
+    uint32_t remaining = stamp.size;
+    uint16_t save = bank_map(firstBank);
+    while (remaining)
+    {
+        uint16_t chunk = remaining > sizeof(banked_page) ? sizeof(banked_page) : remaining;
+        crc = crc32_update(crc, banked_page, chunk);
+        remaining -= chunk;
+        ApmPageBank++;
+    }
+    bank_unmap(save);
+
+    return crc == stamp.crc;
+}
+
+// Record that a file has been loaded into banked memory
+void bank_write_stamp(uint8_t slot, uint8_t firstBank, FILINFO* pfi, uint32_t crc)
+{
+    LOADSTAMP stamp;
+    memset(&stamp, 0, sizeof(stamp));
+    stamp.signature = STAMP_SIGNATURE;
+    stamp.size = pfi->fsize;
+    stamp.fdate = pfi->fdate;
+    stamp.ftime = pfi->ftime;
+    stamp.crc = crc;
+    stamp.firstBank = firstBank;
+    bank_write(BANK_STAMPS, slot * sizeof(LOADSTAMP), &stamp, sizeof(LOADSTAMP));
+}
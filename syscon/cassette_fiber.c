@@ -14,9 +14,35 @@ const char* g_pszCasSaveFile = NULL;
 // Cassette operation status
 static FIL* pFile = NULL;
 static bool bIsRecording = false;
-static bool g_bStopNextBlock = false;
+static bool bFromRam = false;
 static FSIZE_t pos = 0;
 
+// Tapes up to this size are preloaded into banked RAM when selected and
+// played from there so playback doesn't depend on SD card latency
+#define CAS_PRELOAD_BANKS	32
+static uint8_t g_casBank = 0;
+static uint32_t g_casPreloadSize = 0;		// 0 = not preloaded
+
+// Programs found on the selected tape and where playback starts
+CASPROGRAM g_casIndex[CAS_INDEX_MAX];
+uint8_t g_casIndexCount = 0;
+uint32_t g_casStartPos = 0;
+
+// Tape indexes are cached in a file next to the tape (.cix)
+#define CAS_INDEX_SIGNATURE		0xB180C1A5UL
+
+typedef struct tagCASINDEXHEADER
+{
+	uint32_t signature;
+	uint32_t size;
+	uint16_t fdate;
+	uint16_t ftime;
+	uint8_t count;
+} CASINDEXHEADER;
+
+// A leader needs at least this many zero bytes before the sync byte
+#define CAS_MIN_LEADER		32
+
 void cas_set_block_number(uint32_t blockNumber) __naked
 {
 __asm
@@ -31,14 +57,393 @@ __asm
 __endasm;
 }
 
+// Send data to the cassette direct data port
+void cas_write_data(const void* p, uint16_t length) __naked
+{
+	p; length;
+__asm
+		ld	hl, #2
+		add hl,sp
+		ld	e,(hl)
+		inc	hl
+		ld	d,(hl)
+		inc	hl
+		ld	a,(hl)
+		inc	hl
+		ld	h,(hl)
+		ld	l,a
+		ex	de,hl
+
+        ; HL = data, DE = length, C = port number
+		ld	c,#CASSETTE_DIRECT_PORT
+
+		; Whole 256 byte runs (B = 0)
+10$:
+		ld	a,d
+		or	a
+		jr	z,20$
+		ld	b,#0
+		otir
+		dec	d
+		jr	10$
+
+		; Remainder
+20$:
+		ld	a,e
+		or	a
+		ret	z
+		ld	b,a
+		otir
+		ret
+__endasm;
+}
+
+// Build the name of the index file for a tape (replaces the extension)
+static void cas_index_filename(char* psz, const char* pszTape)
+{
+	strcpy(psz, pszTape);
+	char* pDot = strrchr(psz, '.');
+	if (pDot == NULL || strchr(pDot, '/') != NULL)
+		pDot = psz + strlen(psz);
+	strcpy(pDot, ".cix");
+}
+
+// Decode a program's type and name from the 7 bytes following its sync byte
+static bool cas_parse_header(CASPROGRAM* pProgram, const uint8_t* hdr)
+{
+	uint8_t nameLength;
+	if (hdr[0] == 0x55)
+	{
+		// SYSTEM tape, 6 character name
+		pProgram->type = 'S';
+		nameLength = 6;
+	}
+	else if (hdr[0] == 0xD3 && hdr[1] == 0xD3 && hdr[2] == 0xD3)
+	{
+		// BASIC tape, 1 character name
+		pProgram->type = 'B';
+		hdr += 2;
+		nameLength = 1;
+	}
+	else
+	{
+		return false;
+	}
+
+	for (uint8_t i=0; i<nameLength; i++)
+	{
+		char ch = hdr[i + 1];
+		pProgram->name[i] = (ch >= 0x20 && ch < 0x7F) ? ch : '?';
+	}
+	while (nameLength > 0 && pProgram->name[nameLength - 1] == ' ')
+		nameLength--;
+	pProgram->name[nameLength] = '\0';
+	return true;
+}
+
+// Add a program to the index given the 7 bytes following its sync byte
+static void cas_index_add(uint32_t offset, const uint8_t* hdr)
+{
+	if (g_casIndexCount >= CAS_INDEX_MAX)
+		return;
+
+	CASPROGRAM* pProgram = &g_casIndex[g_casIndexCount];
+	if (!cas_parse_header(pProgram, hdr))
+		return;
+
+	pProgram->offset = offset;
+	g_casIndexCount++;
+}
+
+// Scan a tape for leaders followed by SYSTEM or BASIC headers
+static void cas_index_scan(FIL* pf)
+{
+	uint8_t buf[128];
+	uint8_t hdr[7];
+	uint8_t hdrLength = sizeof(hdr);
+	uint16_t zeros = 0;
+	uint32_t offset = 0;
+	uint32_t leaderStart = 0;
+
+	while (true)
+	{
+		UINT bytes_read = 0;
+		if (f_read(pf, buf, sizeof(buf), &bytes_read) || bytes_read == 0)
+			break;
+
+		for (UINT i=0; i<bytes_read; i++, offset++)
+		{
+			uint8_t b = buf[i];
+
+			// Collecting header bytes after a sync byte?
+			if (hdrLength < sizeof(hdr))
+			{
+				hdr[hdrLength++] = b;
+				if (hdrLength == sizeof(hdr))
+					cas_index_add(leaderStart, hdr);
+			}
+
+			if (b == 0)
+			{
+				zeros++;
+				continue;
+			}
+
+			if (b == 0xA5 && zeros >= CAS_MIN_LEADER && hdrLength == sizeof(hdr))
+			{
+				leaderStart = offset - zeros;
+				hdrLength = 0;
+			}
+			zeros = 0;
+		}
+	}
+}
+
+// Load the selected tape's program index, scanning the tape if there's
+// no up to date index file
+static void cas_load_index()
+{
+	g_casIndexCount = 0;
+	g_casStartPos = 0;
+
+	FILINFO fi;
+	if (!g_pszCasFile || !g_pszCasFile[0] || f_stat(g_pszCasFile, &fi))
+		return;
+
+	char* pszIndexFile = (char*)malloc(strlen(g_pszCasFile) + 5);
+	cas_index_filename(pszIndexFile, g_pszCasFile);
+
+	FIL* pf = (FIL*)malloc(sizeof(FIL));
+	UINT bytes;
+
+	// Try the cached index
+	CASINDEXHEADER hdr;
+	if (f_open(pf, pszIndexFile, FA_OPEN_EXISTING | FA_READ) == 0)
+	{
+		bool ok = f_read(pf, &hdr, sizeof(hdr), &bytes) == 0 &&
+			bytes == sizeof(hdr) &&
+			hdr.signature == CAS_INDEX_SIGNATURE &&
+			hdr.size == fi.fsize &&
+			hdr.fdate == fi.fdate &&
+			hdr.ftime == fi.ftime &&
+			hdr.count <= CAS_INDEX_MAX &&
+			f_read(pf, g_casIndex, hdr.count * sizeof(CASPROGRAM), &bytes) == 0 &&
+			bytes == hdr.count * sizeof(CASPROGRAM);
+		f_close(pf);
+
+		if (ok)
+		{
+			g_casIndexCount = hdr.count;
+			goto exit;
+		}
+	}
+
+	// Scan the tape
+	if (f_open(pf, g_pszCasFile, FA_OPEN_EXISTING | FA_READ) == 0)
+	{
+		cas_index_scan(pf);
+		f_close(pf);
+
+		// Save it for next time
+		if (f_open(pf, pszIndexFile, FA_CREATE_ALWAYS | FA_WRITE) == 0)
+		{
+			hdr.signature = CAS_INDEX_SIGNATURE;
+			hdr.size = fi.fsize;
+			hdr.fdate = fi.fdate;
+			hdr.ftime = fi.ftime;
+			hdr.count = g_casIndexCount;
+			f_write(pf, &hdr, sizeof(hdr), &bytes);
+			f_write(pf, g_casIndex, g_casIndexCount * sizeof(CASPROGRAM), &bytes);
+			f_close(pf);
+		}
+	}
+
+exit:
+	free(pf);
+	free(pszIndexFile);
+}
+
+// Read the selected tape into banked RAM and load its program index
+void cassette_preload()
+{
+	g_casPreloadSize = 0;
+
+	// Stop playback from RAM before overwriting it
+	if (bFromRam)
+		CassetteCmdStatusPort = CASSETTE_COMMAND_STOP;
+
+	cas_load_index();
+
+	if (!g_casBank || !g_pszCasFile || !g_pszCasFile[0])
+		return;
+
+	FIL* pf = (FIL*)malloc(sizeof(FIL));
+	if (f_open(pf, g_pszCasFile, FA_OPEN_EXISTING | FA_READ))
+	{
+		free(pf);
+		return;
+	}
+
+	// Big tapes are streamed from the SD card instead.  FatFS can yield to
+	// other fibers so read into syscon RAM and copy to the bank rather than
+	// leaving the bank mapped across the read.
+	BYTE* pBuf = (BYTE*)malloc(512);
+	if (pBuf && f_size(pf) <= (uint32_t)CAS_PRELOAD_BANKS * sizeof(banked_page))
+	{
+		uint32_t total = 0;
+		while (true)
+		{
+			UINT bytes_read = 0;
+			if (f_read(pf, pBuf, 512, &bytes_read))
+			{
+				total = 0;
+				break;
+			}
+			bank_write(g_casBank, (uint16_t)total, pBuf, bytes_read);
+			total += bytes_read;
+			if (bytes_read != 512)
+				break;
+		}
+
+		g_casPreloadSize = total;
+	}
+
+	free(pBuf);
+	f_close(pf);
+	free(pf);
+}
+
+// Every byte CSAVE (and most SYSTEM tape writers) writes goes through the
+// Level II ROM's cassette byte write routine at 0264h, including the
+// leader and sync byte.  For fast save its entry is replaced with
+// OUT (0FEh),A and RET so each byte goes straight into the recorder's
+// buffer (see Trs80Model1Core.vhd) and the TRS-80 runs at turbo speed
+// while the motor's on.
+#define ROM_CAS_WRITE_BYTE		0x0264
+
+static const uint8_t g_romCasWriteByte[] = { 0xE5, 0xC5, 0xD5 };	// push hl, push bc, push de
+static const uint8_t g_romCasWriteByteFast[] = { 0xD3, 0xFE, 0xC9 };	// out (0feh),a; ret
+
+static void rom_replace(const uint8_t* pFrom, const uint8_t* pTo)
+{
+	uint8_t code[sizeof(g_romCasWriteByte)];
+	bank_read(0, ROM_CAS_WRITE_BYTE, code, sizeof(code));
+
+	// Leave unrecognized ROMs alone
+	if (memcmp(code, pFrom, sizeof(code)) == 0)
+		bank_write(0, ROM_CAS_WRITE_BYTE, pTo, sizeof(code));
+}
+
+// Apply or remove the fast save patch to match the current options
+void cassette_patch_rom()
+{
+	if (OptionsPort & OPTION_FAST_SAVE)
+		rom_replace(g_romCasWriteByte, g_romCasWriteByteFast);
+	else
+		cassette_unpatch_rom();
+}
+
+// Restore the original ROM code (so the resident ROM matches its load 
+// stamp on a warm reset)
+void cassette_unpatch_rom()
+{
+	rom_replace(g_romCasWriteByteFast, g_romCasWriteByte);
+}
+
+// After a fast save, rename the recording after the program on it (so 
+// unlike "Save Recording" the data isn't copied a second time)
+static void cas_name_recording()
+{
+	FIL* pf = (FIL*)malloc(sizeof(FIL));
+	if (f_open(pf, "/RECORD.CAS", FA_OPEN_EXISTING | FA_READ))
+	{
+		free(pf);
+		return;
+	}
+
+	uint8_t buf[64];
+	UINT bytes_read = 0;
+	f_read(pf, buf, sizeof(buf), &bytes_read);
+	f_close(pf);
+	free(pf);
+
+	// Skip the leader
+	UINT i = 0;
+	while (i < bytes_read && buf[i] == 0)
+		i++;
+	if (i < CAS_MIN_LEADER || i + 8 > bytes_read || buf[i] != 0xA5)
+		return;
+
+	CASPROGRAM program;
+	if (!cas_parse_header(&program, buf + i + 1))
+		return;
+
+	// Names can contain characters that aren't valid in file names
+	if (program.name[0] == '\0')
+		return;
+	for (char* p = program.name; *p; p++)
+	{
+		if (!((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9')))
+			*p = '_';
+	}
+
+	// Never replace an existing file, number the name instead (NAME.CAS,
+	// NAME_1.CAS ... NAME_9.CAS).  If they're all taken the recording's
+	// left as RECORD.CAS.
+	char szName[16];
+	FRESULT r = FR_EXIST;
+	uint8_t n;
+	for (n = 0; n < 10 && r == FR_EXIST; n++)
+	{
+		if (n == 0)
+			sprintf(szName, "/%s.CAS", program.name);
+		else
+			sprintf(szName, "/%s_%i.CAS", program.name, (int)n);
+		r = f_rename("/RECORD.CAS", szName);
+	}
+	trace_2(TRACE_CAS_SAVED, r, n - 1);
+}
+
+// Supply the next playback block from the preloaded tape
+static void cas_supply_ram_block()
+{
+    trace_2l(TRACE_CAS_BLOCK, pos, 0);
+
+    // (Playback can start anywhere so the block may span banks)
+    CassetteCmdStatusPort = CASSETTE_COMMAND_DIRECT_BLOCK;
+    uint8_t bank = g_casBank + (uint8_t)(pos >> 10);
+    uint16_t offset = (uint16_t)pos & 0x3FF;
+    uint16_t length = offset > 512 ? 1024 - offset : 512;
+    uint16_t save = bank_map(bank);
+    cas_write_data(banked_page + offset, length);
+    if (length < 512)
+    {
+        ApmPageBank = bank + 1;
+        cas_write_data(banked_page, 512 - length);
+    }
+    bank_unmap(save);
+
+    pos += 512;
+}
+
 // Handle IRQs
 void handle_irq()
 {
-    if (pFile != NULL)
+    if (bFromRam)
+    {
+        // Playback from RAM stopped?
+        if ((CassetteCmdStatusPort & CASSETTE_STATUS_PLAYING) == 0)
+        {
+            bFromRam = false;
+            return;
+        }
+    }
+    else if (pFile != NULL)
     {
         // Operation stopped?  Close the file
         if ((CassetteCmdStatusPort & (CASSETTE_STATUS_PLAYING|CASSETTE_STATUS_RECORDING)) == 0)
         {
+            bool bWasRecording = bIsRecording;
             if (bIsRecording)
             {
                 // Seek past last block to set file size
@@ -49,6 +454,9 @@ void handle_irq()
             free(pFile);
             pFile = NULL;
             bIsRecording = false;
+
+            if (bWasRecording && (OptionsPort & OPTION_FAST_SAVE))
+                cas_name_recording();
             return;
         }
     }
@@ -67,6 +475,13 @@ void handle_irq()
                 return;
             }
 
+            // Play from RAM?
+            if (g_casPreloadSize)
+            {
+                bFromRam = true;
+                pos = g_casStartPos;
+            }
+
             pszFileToOpen = g_pszCasFile;
             bMode = FA_OPEN_EXISTING | FA_READ;
         }
@@ -79,10 +494,13 @@ void handle_irq()
 
 
         // Open/create the file
-        if (pszFileToOpen)
+        if (pszFileToOpen && !bFromRam)
         {
             pFile = (FIL*)malloc(sizeof(FIL));
-            pos = 0;
+
+            // Blocks are loaded a whole sector at a time so start at the
+            // beginning of the sector containing the selected program
+            pos = bIsRecording ? 0 : (g_casStartPos & ~511UL);
             if (f_open(pFile, pszFileToOpen, bMode))
             {
                 CassetteCmdStatusPort = CASSETTE_COMMAND_STOP;
@@ -91,38 +509,33 @@ void handle_irq()
                 return;
             }
         }
-
-        g_bStopNextBlock = false;
     }
 
-    if (!pFile)
+    if (!pFile && !bFromRam)
         return;
 
     // Need a block number?
     if (CassetteCmdStatusPort & CASSETTE_STATUS_NEED_BLOCK)
     {
-        // Stop after EOF?
-        if (g_bStopNextBlock)
+        // Check for attempt to play past end of file?
+        if (!bIsRecording && pos >= (bFromRam ? g_casPreloadSize : pFile->obj.objsize))
         {
-            g_bStopNextBlock = false;
-            CassetteCmdStatusPort = CASSETTE_COMMAND_STOP;
+            // We're past the end of the file.  Leave the request
+            // unanswered so the current block finishes rendering,
+            // after which the streamer stalls (and raises another
+            // irq) and playback can be stopped.
+            if (CassetteCmdStatusPort & CASSETTE_STATUS_STALLED)
+                CassetteCmdStatusPort = CASSETTE_COMMAND_STOP;
             return;
         }
 
-        // Check for attempt to play past end of file?
-        if (!bIsRecording && pos >= pFile->obj.objsize)
+        // Supply the block directly from RAM
+        if (bFromRam)
         {
-            // We're past the end of the file, but need to wait
-            // for the current block to finish rendering.  Just
-            // load the same sector again (coult be anything, don't
-            // care), but set a flag to stop playback on the next
-            // block request
-            CassetteCmdStatusPort = CASSETTE_COMMAND_LOAD_BLOCK;
-            g_bStopNextBlock = true;
+            cas_supply_ram_block();
             return;
         }
 
-
         // Seek to the next position
         if (f_lseek(pFile, pos) != FR_OK)
         {
@@ -136,14 +549,15 @@ void handle_irq()
         else
             f_current_sector(pFile, &sector);
 
-/*
-        sprintf(g_szTemp, "pos:%i block:%i\n", 
-                (int)pos, 
-                (int)sector,
-                (int)pFile->obj.objsize
-                );
-        uart_write_sz(g_szTemp);
-*/
+        trace_2l(TRACE_CAS_BLOCK, pos, sector);
+
+        // The hardware transfers the sector directly so the cache mustn't
+        // hold a copy.  Recording reuses the clusters of the previous 
+        // recording and a stale (possibly dirty) copy would be read back 
+        // by FatFS or written over the new data.  Playback files are closed
+        // and synced so there's nothing unwritten to lose.
+        disk_cache_invalidate(sector);
+
         // Load it
         cas_set_block_number(sector);
         CassetteCmdStatusPort = CASSETTE_COMMAND_LOAD_BLOCK;
@@ -170,12 +584,68 @@ void cassette_fiber_proc()
 
 void cassette_init()
 {
+    // Allocate RAM for preloaded tapes and load the current tape
+    g_casBank = bank_alloc(CAS_PRELOAD_BANKS);
+    cassette_preload();
+    cassette_patch_rom();
+
     init_signal(&g_sig_cassette);
     create_fiber(cassette_fiber_proc, 1024);
 }
 
+// Number of blocks that weren't supplied before the streamer ran dry
+uint16_t g_casLateBlocks = 0;
+
+// Count a block request that arrived after the streamer had already run
+// dry (but not running off the end of the tape)
+static void cas_check_late(uint8_t status, uint32_t size)
+{
+    if ((status & CASSETTE_STATUS_STALLED) && pos < size)
+    {
+        g_casLateBlocks++;
+        trace_2l(TRACE_CAS_LATE, pos, g_casLateBlocks);
+    }
+}
+
+// Supply a requested block from the preloaded tape straight away, returns
+// true if one was supplied.  Preloaded tapes don't need the file system
+// so this is safe to call from any fiber and long running code that
+// doesn't otherwise yield calls it (eg: window_proc_hook for every UI
+// message, cmd_screen for every row) so preloaded playback isn't held up
+// until the fiber loop gets back to cassette_isr.  (bFromRam is only ever
+// set while the cassette fiber is waiting for a signal, never part way
+// through handle_irq)
+bool cassette_poll()
+{
+    if (!bFromRam || bIsRecording || (InterruptControllerPort & IRQ_CASSETTE) == 0)
+        return false;
+
+    uint8_t status = CassetteCmdStatusPort;
+    if (!(status & CASSETTE_STATUS_NEED_BLOCK) || !(status & CASSETTE_STATUS_PLAYING) || pos >= g_casPreloadSize)
+        return false;
+
+    cas_check_late(status, g_casPreloadSize);
+    cas_supply_ram_block();
+    return true;
+}
+
+// The cassette has a hard deadline (the streamer stalls the TRS-80 once
+// its buffer runs dry) while the other fibers can run for a long time
+// between yields.  Preloaded tape blocks are supplied here (and from
+// cassette_poll), before any fiber gets to run.  Tapes streamed from the
+// SD card need FatFS so their blocks are left to the fiber and have no
+// bounded deadline.
 void cassette_isr()
 {
-    if (InterruptControllerPort & IRQ_CASSETTE)
-        set_signal(&g_sig_cassette);
-}
\ No newline at end of file
+    if ((InterruptControllerPort & IRQ_CASSETTE) == 0)
+        return;
+
+    if (cassette_poll())
+        return;
+
+    uint8_t status = CassetteCmdStatusPort;
+    if ((status & CASSETTE_STATUS_NEED_BLOCK) && !bIsRecording && !bFromRam && pFile != NULL)
+        cas_check_late(status, pFile->obj.objsize);
+
+    set_signal(&g_sig_cassette);
+}
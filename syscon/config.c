@@ -1,7 +1,7 @@
 #include "syscon.h"
 
 #define CONFIG_SIGNATURE 0xb180
-#define CONFIG_VERSION	3
+#define CONFIG_VERSION	5
 
 typedef struct tagCONFIG
 {
@@ -71,6 +71,32 @@ void config_load()
 		g_pszCasSaveFile = f_read_str(pf);
 	}
 
+	if (cfg.version >= 4)
+	{
+		uint8_t speed;
+		if (f_read(pf, &speed, 1, &bytes_read) == 0 && bytes_read == 1)
+		{
+			// Clamp unknown speeds
+			speed &= SPEED_MASK | SPEED_AUTO_TURBO;
+			if ((speed & SPEED_MASK) > SPEED_MAX)
+				speed = (speed & ~SPEED_MASK) | SPEED_MAX;
+			SpeedPort = speed;
+		}
+	}
+
+	if (cfg.version >= 5)
+	{
+		for (uint8_t i=0; i<DISK_DRIVES; i++)
+		{
+			g_pszDiskFile[i] = f_read_str(pf);
+			if (g_pszDiskFile[i] && g_pszDiskFile[i][0] == '\0')
+			{
+				free(g_pszDiskFile[i]);
+				g_pszDiskFile[i] = NULL;
+			}
+		}
+	}
+
 
 exit:
 	f_close(pf);
@@ -98,6 +124,10 @@ void config_save()
 	f_write(pf, (BYTE*)&cfg, sizeof(cfg), &bytes_written);
 	f_write_str(pf, g_pszCasFile);
 	f_write_str(pf, g_pszCasSaveFile);
+	uint8_t speed = SpeedPort;
+	f_write(pf, &speed, 1, &bytes_written);
+	for (uint8_t i=0; i<DISK_DRIVES; i++)
+		f_write_str(pf, g_pszDiskFile[i]);
 
 	// Done
 	f_close(pf);
@@ -0,0 +1,30 @@
+#include "syscon.h"
+
+// Calculate the crc of a file, returns FatFS error code
+FRESULT crc32_file(const char* pszFileName, uint32_t* pCrc, uint32_t* pSize)
+{
+    FIL f;
+    FRESULT err = f_open(&f, pszFileName, FA_OPEN_EXISTING | FA_READ);
+    if (err)
+        return err;
+
+    uint32_t crc = 0;
+    uint32_t size = 0;
+    char buf[128];
+    while (true)
+    {
+        UINT bytes_read;
+        err = f_read(&f, buf, sizeof(buf), &bytes_read);
+        if (err || bytes_read == 0)
+            break;
+
+        crc = crc32_update(crc, buf, bytes_read);
+        size += bytes_read;
+    }
+
+    f_close(&f);
+
+    *pCrc = crc;
+    *pSize = size;
+    return err;
+}
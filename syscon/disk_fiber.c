@@ -0,0 +1,1061 @@
+#include "syscon.h"
+
+// Services the floppy disk controller (Trs80FloppyController.vhd).
+//
+// Disk images (JV1, JV3 and DMK) are read a track at a time into a cache
+// in the spare external RAM banks.  FDC read/write sector commands are
+// then served from the cache and dirty tracks are written back to the
+// SD card when the track is evicted, the drive motors stop (2 seconds 
+// after the last drive select), the disk is ejected or the machine is
+// reset from the menu.
+//
+// The Model I has no standard side select so only side 0 is accessed.
+
+// Image formats
+#define FORMAT_NONE		0
+#define FORMAT_JV1		1
+#define FORMAT_JV3		2
+#define FORMAT_DMK		3
+
+// JV1 geometry (single density, 10 x 256 byte sectors per track)
+#define JV1_SECTORS_PER_TRACK	10
+#define JV1_TRACK_SIZE			(JV1_SECTORS_PER_TRACK * 256)
+#define JV1_DIR_TRACK			17
+
+// JV3 header
+#define JV3_ENTRIES			2901
+#define JV3_HEADER_SIZE		(JV3_ENTRIES * 3 + 1)
+#define JV3_HEADER_BANKS	((JV3_HEADER_SIZE + 1023) / 1024)
+#define JV3_FREE			0xFF
+#define JV3_DENSITY			0x80
+#define JV3_DAM				0x60
+#define JV3_SIDE			0x10
+#define JV3_ERROR			0x08
+#define JV3_SIZE			0x03
+
+// DMK header
+#define DMK_HEADER_SIZE			16
+#define DMK_IDAM_COUNT			64
+#define DMK_IDAM_TABLE_SIZE		(DMK_IDAM_COUNT * 2)
+#define DMK_IDAM_DD				0x8000
+#define DMK_IDAM_OFFSET			0x3FFF
+#define DMK_OPT_SINGLE_SIDED	0x10
+#define DMK_OPT_SD_SINGLE_BYTE	0x40
+#define DMK_OPT_IGNORE_DENSITY	0x80
+
+// Track cache
+#define TRACK_SLOTS			4
+#define TRACK_SLOT_BANKS	7
+#define TRACK_SLOT_SIZE		(TRACK_SLOT_BANKS * 1024)
+#define TRACK_MAX_SECTORS	32
+
+// Bytes per track for write track (FD1771, single density)
+#define WRITE_TRACK_BYTES	3125
+
+// FD1771 status bits
+#define FDC_STATUS_NOT_READY		0x80
+#define FDC_STATUS_WRITE_PROTECT	0x40
+#define FDC_STATUS_WRITE_FAULT		0x20
+#define FDC_STATUS_RNF				0x10
+#define FDC_STATUS_CRC_ERROR		0x08
+
+// Sector flags
+#define SECTOR_DAM_MASK		0x03		// 0 = FB, 1 = FA, 2 = F9, 3 = F8
+#define SECTOR_CRC_ERROR	0x08
+#define SECTOR_DOUBLED		0x10		// DMK single density with doubled bytes
+#define SECTOR_DD			0x20		// Double density
+#define SECTOR_DIRTY		0x80
+
+typedef struct tagSECTOR
+{
+	uint8_t idTrack;
+	uint8_t idSide;
+	uint8_t idSector;
+	uint8_t sizeCode;
+	uint8_t flags;
+	uint16_t offset;			// Offset of sector data in track slot
+	uint32_t filePos;			// File position of sector data (JV1/JV3)
+	uint16_t jv3Entry;			// Header entry (JV3)
+} SECTOR;
+
+typedef struct tagTRACKSLOT
+{
+	uint8_t drive;				// 0xFF if slot unused
+	uint8_t track;
+	uint8_t side;
+	uint8_t sectorCount;
+	uint8_t age;
+	bool dirty;
+	uint8_t nextAddress;		// Next sector for read address
+	SECTOR sectors[TRACK_MAX_SECTORS];
+} TRACKSLOT;
+
+typedef struct tagDRIVE
+{
+	FIL* pFile;
+	uint8_t format;
+	bool writeProtect;
+	uint8_t tracks;
+	uint8_t sides;
+	uint16_t dmkTrackLength;
+	uint8_t dmkOptions;
+	uint8_t jv3HeaderBank;
+} DRIVE;
+
+const char* g_pszDiskFile[DISK_DRIVES];
+static DRIVE g_drives[DISK_DRIVES];
+static TRACKSLOT g_slots[TRACK_SLOTS];
+static uint8_t g_slotBank = 0;
+static SIGNAL g_sig_fdc;
+
+// Pending write sector/track state
+static TRACKSLOT* g_pWriteSlot;
+static SECTOR* g_pWriteSector;
+static uint16_t g_writeTrackBytes;
+static uint8_t g_fmtState;
+static uint8_t g_fmtId[4];
+static uint8_t g_fmtIdPos;
+static bool g_fmtHaveId;
+static SECTOR* g_pFmtSector;
+static uint16_t g_fmtPos;
+static uint16_t g_fmtRemaining;
+static uint8_t g_fmtDam;
+static bool g_fmtError;
+
+#define FMT_SCAN	0
+#define FMT_ID		1
+#define FMT_DATA	2
+
+// Copy data to the FDC sector buffer
+void fdc_write_buffer(const void* p, uint8_t count) __naked
+{
+	p; count;
+__asm
+		ld	hl, #2
+		add hl, sp
+		ld	e, (hl)
+		inc	hl
+		ld	d, (hl)
+		inc	hl
+		ld	b, (hl)
+		ex	de, hl
+		ld	c, #FDC_BUFFER_PORT
+		otir
+		ret
+__endasm;
+}
+
+// Copy data from the FDC sector buffer
+void fdc_read_buffer(void* p, uint8_t count) __naked
+{
+	p; count;
+__asm
+		ld	hl, #2
+		add hl, sp
+		ld	e, (hl)
+		inc	hl
+		ld	d, (hl)
+		inc	hl
+		ld	b, (hl)
+		ex	de, hl
+		ld	c, #FDC_BUFFER_PORT
+		inir
+		ret
+__endasm;
+}
+
+static uint16_t sector_size(uint8_t sizeCode)
+{
+	return 128 << (sizeCode & 3);
+}
+
+static uint8_t slot_bank(TRACKSLOT* pSlot)
+{
+	return g_slotBank + (uint8_t)(pSlot - g_slots) * TRACK_SLOT_BANKS;
+}
+
+// Read sector data from the track cache (max 64 bytes)
+static void sector_read(TRACKSLOT* pSlot, SECTOR* pSector, uint16_t pos, uint8_t* p, uint8_t length)
+{
+	if (pSector->flags & SECTOR_DOUBLED)
+	{
+		uint8_t raw[128];
+		bank_read(slot_bank(pSlot), pSector->offset + pos * 2, raw, length * 2);
+		for (uint8_t i=0; i<length; i++)
+			p[i] = raw[i * 2];
+	}
+	else
+	{
+		bank_read(slot_bank(pSlot), pSector->offset + pos, p, length);
+	}
+}
+
+// Write sector data to the track cache (max 64 bytes)
+static void sector_write(TRACKSLOT* pSlot, SECTOR* pSector, uint16_t pos, const uint8_t* p, uint8_t length)
+{
+	if (pSector->flags & SECTOR_DOUBLED)
+	{
+		uint8_t raw[128];
+		for (uint8_t i=0; i<length; i++)
+		{
+			raw[i * 2] = p[i];
+			raw[i * 2 + 1] = p[i];
+		}
+		bank_write(slot_bank(pSlot), pSector->offset + pos * 2, raw, length * 2);
+	}
+	else
+	{
+		bank_write(slot_bank(pSlot), pSector->offset + pos, p, length);
+	}
+}
+
+// Calculate the data crc of a DMK sector (DAM + data)
+static uint16_t dmk_sector_crc(TRACKSLOT* pSlot, SECTOR* pSector)
+{
+	uint8_t buf[64];
+	uint16_t crc = 0xFFFF;
+	if (pSector->flags & SECTOR_DD)
+	{
+		buf[0] = buf[1] = buf[2] = 0xA1;
+		crc = crc16_update(crc, buf, 3);
+	}
+
+	buf[0] = 0xFB - (pSector->flags & SECTOR_DAM_MASK);
+	crc = crc16_update(crc, buf, 1);
+
+	uint16_t size = sector_size(pSector->sizeCode);
+	for (uint16_t pos = 0; pos < size; pos += sizeof(buf))
+	{
+		sector_read(pSlot, pSector, pos, buf, sizeof(buf));
+		crc = crc16_update(crc, buf, sizeof(buf));
+	}
+	return crc;
+}
+
+// After writing a sector's data, update the DAM and CRC
+static void finish_sector_write(TRACKSLOT* pSlot, SECTOR* pSector, uint8_t dam)
+{
+	DRIVE* pDrive = &g_drives[pSlot->drive];
+
+	pSector->flags = (pSector->flags & ~(SECTOR_DAM_MASK | SECTOR_CRC_ERROR)) | (dam & SECTOR_DAM_MASK) | SECTOR_DIRTY;
+	pSlot->dirty = true;
+
+	if (pDrive->format == FORMAT_DMK)
+	{
+		// DAM is immediately before the data, CRC immediately after
+		uint16_t crc = dmk_sector_crc(pSlot, pSector);
+		uint8_t buf[2];
+		buf[0] = 0xFB - dam;
+		sector_write(pSlot, pSector, (uint16_t)-1, buf, 1);
+		buf[0] = crc >> 8;
+		buf[1] = crc & 0xFF;
+		sector_write(pSlot, pSector, sector_size(pSector->sizeCode), buf, 2);
+	}
+	else if (pDrive->format == FORMAT_JV3)
+	{
+		// Update DAM in the header
+		uint8_t flags;
+		bank_read(pDrive->jv3HeaderBank, pSector->jv3Entry * 3 + 2, &flags, 1);
+		if (flags & JV3_DENSITY)
+			flags = (flags & ~JV3_DAM) | (dam ? 0x20 : 0);
+		else
+			flags = (flags & ~JV3_DAM) | (dam << 5);
+		bank_write(pDrive->jv3HeaderBank, pSector->jv3Entry * 3 + 2, &flags, 1);
+	}
+}
+
+// Copy data between the image file and the track cache
+static bool file_to_slot(FIL* pFile, FSIZE_t filePos, TRACKSLOT* pSlot, uint16_t offset, uint16_t length)
+{
+	if (f_lseek(pFile, filePos))
+		return false;
+
+	uint8_t buf[128];
+	while (length)
+	{
+		UINT chunk = length > sizeof(buf) ? sizeof(buf) : length;
+		UINT bytes_read = 0;
+		if (f_read(pFile, buf, chunk, &bytes_read))
+			return false;
+		if (bytes_read < chunk)
+			memset(buf + bytes_read, 0xE5, chunk - bytes_read);
+		bank_write(slot_bank(pSlot), offset, buf, chunk);
+		offset += chunk;
+		length -= chunk;
+	}
+	return true;
+}
+
+static bool slot_to_file(TRACKSLOT* pSlot, uint16_t offset, FIL* pFile, FSIZE_t filePos, uint16_t length)
+{
+	if (f_lseek(pFile, filePos))
+		return false;
+
+	uint8_t buf[128];
+	while (length)
+	{
+		UINT chunk = length > sizeof(buf) ? sizeof(buf) : length;
+		UINT bytes_written = 0;
+		bank_read(slot_bank(pSlot), offset, buf, chunk);
+		if (f_write(pFile, buf, chunk, &bytes_written) || bytes_written != chunk)
+			return false;
+		offset += chunk;
+		length -= chunk;
+	}
+	return true;
+}
+
+// Write a dirty track back to the image file
+static void flush_slot(TRACKSLOT* pSlot)
+{
+	if (!pSlot->dirty)
+		return;
+
+	DRIVE* pDrive = &g_drives[pSlot->drive];
+	if (pDrive->format == FORMAT_DMK)
+	{
+		// Write the entire raw track
+		FSIZE_t pos = DMK_HEADER_SIZE + ((FSIZE_t)pSlot->track * pDrive->sides + pSlot->side) * pDrive->dmkTrackLength;
+		slot_to_file(pSlot, 0, pDrive->pFile, pos, pDrive->dmkTrackLength);
+	}
+	else
+	{
+		// Write dirty sectors
+		for (uint8_t i=0; i<pSlot->sectorCount; i++)
+		{
+			SECTOR* pSector = &pSlot->sectors[i];
+			if ((pSector->flags & SECTOR_DIRTY) == 0)
+				continue;
+
+			slot_to_file(pSlot, pSector->offset, pDrive->pFile, pSector->filePos, sector_size(pSector->sizeCode));
+
+			if (pDrive->format == FORMAT_JV3)
+			{
+				uint8_t entry[3];
+				UINT unused;
+				bank_read(pDrive->jv3HeaderBank, pSector->jv3Entry * 3, entry, 3);
+				f_lseek(pDrive->pFile, pSector->jv3Entry * 3);
+				f_write(pDrive->pFile, entry, 3, &unused);
+			}
+		}
+	}
+
+	for (uint8_t i=0; i<pSlot->sectorCount; i++)
+		pSlot->sectors[i].flags &= ~SECTOR_DIRTY;
+
+	f_sync(pDrive->pFile);
+	pSlot->dirty = false;
+}
+
+static SECTOR* add_sector(TRACKSLOT* pSlot)
+{
+	if (pSlot->sectorCount >= TRACK_MAX_SECTORS)
+		return NULL;
+	SECTOR* pSector = &pSlot->sectors[pSlot->sectorCount++];
+	memset(pSector, 0, sizeof(SECTOR));
+	return pSector;
+}
+
+// Track loaders return false if the image couldn't be read (a track that
+// doesn't exist on the disk isn't an error, it just has no sectors)
+static bool load_jv1_track(DRIVE* pDrive, TRACKSLOT* pSlot)
+{
+	if (pSlot->track >= pDrive->tracks || pSlot->side != 0)
+		return true;
+
+	FSIZE_t pos = (FSIZE_t)pSlot->track * JV1_TRACK_SIZE;
+	if (!file_to_slot(pDrive->pFile, pos, pSlot, 0, JV1_TRACK_SIZE))
+		return false;
+
+	for (uint8_t i=0; i<JV1_SECTORS_PER_TRACK; i++)
+	{
+		SECTOR* pSector = add_sector(pSlot);
+		pSector->idTrack = pSlot->track;
+		pSector->idSector = i;
+		pSector->sizeCode = 1;
+		pSector->offset = i * 256;
+		pSector->filePos = pos + i * 256;
+
+		// By convention the directory track uses the FA data address mark
+		if (pSlot->track == JV1_DIR_TRACK)
+			pSector->flags = 1;
+	}
+	return true;
+}
+
+static bool load_jv3_track(DRIVE* pDrive, TRACKSLOT* pSlot)
+{
+	static const uint16_t usedSizes[] = { 256, 128, 1024, 512 };
+	static const uint16_t freeSizes[] = { 512, 1024, 128, 256 };
+
+	uint8_t entries[126];
+	uint32_t filePos = JV3_HEADER_SIZE;
+	uint16_t offset = 0;
+
+	for (uint16_t i=0; i<JV3_ENTRIES; i++)
+	{
+		// Read header entries in batches
+		uint8_t index = (i % (sizeof(entries) / 3)) * 3;
+		if (index == 0)
+			bank_read(pDrive->jv3HeaderBank, i * 3, entries, sizeof(entries));
+
+		uint8_t track = entries[index];
+		uint8_t sector = entries[index + 1];
+		uint8_t flags = entries[index + 2];
+		uint16_t size = track == JV3_FREE ? freeSizes[flags & JV3_SIZE] : usedSizes[flags & JV3_SIZE];
+
+		if (track == pSlot->track && ((flags & JV3_SIDE) ? 1 : 0) == pSlot->side)
+		{
+			if (offset + size > TRACK_SLOT_SIZE)
+				break;
+
+			SECTOR* pSector = add_sector(pSlot);
+			if (!pSector)
+				break;
+
+			pSector->idTrack = track;
+			pSector->idSide = pSlot->side;
+			pSector->idSector = sector;
+			pSector->sizeCode = size == 128 ? 0 : size == 256 ? 1 : size == 512 ? 2 : 3;
+			pSector->offset = offset;
+			pSector->filePos = filePos;
+			pSector->jv3Entry = i;
+			if (flags & JV3_DENSITY)
+				pSector->flags = SECTOR_DD | ((flags & JV3_DAM) ? 3 : 0);
+			else
+				pSector->flags = (flags & JV3_DAM) >> 5;
+			if (flags & JV3_ERROR)
+				pSector->flags |= SECTOR_CRC_ERROR;
+
+			if (!file_to_slot(pDrive->pFile, filePos, pSlot, offset, size))
+				return false;
+			offset += size;
+		}
+
+		filePos += size;
+	}
+	return true;
+}
+
+static bool load_dmk_track(DRIVE* pDrive, TRACKSLOT* pSlot)
+{
+	if (pSlot->track >= pDrive->tracks || pSlot->side >= pDrive->sides)
+		return true;
+
+	// Read the raw track
+	FSIZE_t pos = DMK_HEADER_SIZE + ((FSIZE_t)pSlot->track * pDrive->sides + pSlot->side) * pDrive->dmkTrackLength;
+	if (!file_to_slot(pDrive->pFile, pos, pSlot, 0, pDrive->dmkTrackLength))
+		return false;
+
+	// Read the IDAM table
+	uint16_t idams[DMK_IDAM_COUNT];
+	bank_read(slot_bank(pSlot), 0, idams, sizeof(idams));
+
+	for (uint8_t i=0; i<DMK_IDAM_COUNT; i++)
+	{
+		uint16_t idam = idams[i];
+		if (idam == 0)
+			break;
+
+		bool dd = (idam & DMK_IDAM_DD) != 0;
+		uint8_t stride = (dd || (pDrive->dmkOptions & (DMK_OPT_SD_SINGLE_BYTE | DMK_OPT_IGNORE_DENSITY))) ? 1 : 2;
+		uint16_t offset = idam & DMK_IDAM_OFFSET;
+
+		// Read the ID field and enough of the following gap to find the DAM
+		uint8_t raw[128];
+		uint8_t rawLength = stride * 50;
+		if (offset + rawLength > pDrive->dmkTrackLength)
+			continue;
+		bank_read(slot_bank(pSlot), offset, raw, rawLength);
+
+		// Find the data address mark
+		uint8_t damSearch = dd ? 43 : 30;
+		uint8_t dam;
+		for (dam = 7; dam < damSearch; dam++)
+		{
+			uint8_t b = raw[dam * stride];
+			if (b >= 0xF8 && b <= 0xFB)
+				break;
+		}
+		if (dam == damSearch)
+			continue;
+
+		SECTOR* pSector = add_sector(pSlot);
+		if (!pSector)
+			break;
+
+		pSector->idTrack = raw[1 * stride];
+		pSector->idSide = raw[2 * stride];
+		pSector->idSector = raw[3 * stride];
+		pSector->sizeCode = raw[4 * stride] & 3;
+		pSector->offset = offset + (dam + 1) * stride;
+		pSector->flags = 0xFB - raw[dam * stride];
+		if (dd)
+			pSector->flags |= SECTOR_DD;
+		if (stride == 2)
+			pSector->flags |= SECTOR_DOUBLED;
+
+		// Make sure sector doesn't run off the end of the track
+		if (pSector->offset + (sector_size(pSector->sizeCode) + 2) * stride > pDrive->dmkTrackLength)
+			pSlot->sectorCount--;
+	}
+	return true;
+}
+
+// Get the track slot for a drive/track/side, loading it if necessary
+static TRACKSLOT* get_track(uint8_t drive, uint8_t track, uint8_t side)
+{
+	TRACKSLOT* pFound = NULL;
+	TRACKSLOT* pOldest = &g_slots[0];
+	for (uint8_t i=0; i<TRACK_SLOTS; i++)
+	{
+		TRACKSLOT* pSlot = &g_slots[i];
+		if (pSlot->drive == drive && pSlot->track == track && pSlot->side == side)
+		{
+			pFound = pSlot;
+		}
+		else
+		{
+			if (pSlot->age < 255)
+				pSlot->age++;
+		}
+
+		if (pSlot->drive == 0xFF || (pOldest->drive != 0xFF && pSlot->age > pOldest->age))
+			pOldest = pSlot;
+	}
+
+	if (pFound)
+	{
+		pFound->age = 0;
+		return pFound;
+	}
+
+	// Evict the oldest slot
+	flush_slot(pOldest);
+	pOldest->drive = drive;
+	pOldest->track = track;
+	pOldest->side = side;
+	pOldest->sectorCount = 0;
+	pOldest->age = 0;
+	pOldest->dirty = false;
+	pOldest->nextAddress = 0;
+
+	trace_2(TRACE_FDC_LOAD, drive, track);
+
+	DRIVE* pDrive = &g_drives[drive];
+	bool ok = true;
+	switch (pDrive->format)
+	{
+		case FORMAT_JV1: ok = load_jv1_track(pDrive, pOldest); break;
+		case FORMAT_JV3: ok = load_jv3_track(pDrive, pOldest); break;
+		case FORMAT_DMK: ok = load_dmk_track(pDrive, pOldest); break;
+	}
+
+	// Read failed, the command sees an empty track (record not found) and 
+	// the slot is released so the next command tries again
+	if (!ok)
+	{
+		trace_2(TRACE_FDC_READ_ERROR, drive, track);
+		pOldest->sectorCount = 0;
+		pOldest->drive = 0xFF;
+	}
+
+	return pOldest;
+}
+
+static SECTOR* find_sector(TRACKSLOT* pSlot, uint8_t idTrack, uint8_t idSector)
+{
+	for (uint8_t i=0; i<pSlot->sectorCount; i++)
+	{
+		SECTOR* pSector = &pSlot->sectors[i];
+		if (pSector->idTrack == idTrack && pSector->idSector == idSector)
+			return pSector;
+	}
+	return NULL;
+}
+
+static void fdc_complete(uint8_t status)
+{
+	FdcResultPort = status;
+	FdcControlPort = FDC_CONTROL_COMPLETE;
+}
+
+static void fdc_start_transfer(uint16_t count)
+{
+	FdcCountLoPort = count & 0xFF;
+	FdcCountHiPort = count >> 8;
+	FdcResetBufferPort = 0;
+	FdcControlPort = FDC_CONTROL_START;
+}
+
+static uint8_t selected_drive()
+{
+	uint8_t sel = FdcDriveSelectPort;
+	for (uint8_t i=0; i<DISK_DRIVES; i++)
+	{
+		if (sel & (1 << i))
+			return i;
+	}
+	return 0xFF;
+}
+
+static void read_sector(TRACKSLOT* pSlot, SECTOR* pSector)
+{
+	DRIVE* pDrive = &g_drives[pSlot->drive];
+	uint8_t status = (pSector->flags & SECTOR_DAM_MASK) << 5;
+	if (pSector->flags & SECTOR_CRC_ERROR)
+		status |= FDC_STATUS_CRC_ERROR;
+
+	// Copy data to the FDC buffer
+	uint8_t buf[64];
+	uint16_t size = sector_size(pSector->sizeCode);
+	FdcResetBufferPort = 0;
+	for (uint16_t pos = 0; pos < size; pos += sizeof(buf))
+	{
+		sector_read(pSlot, pSector, pos, buf, sizeof(buf));
+		fdc_write_buffer(buf, sizeof(buf));
+	}
+
+	// Check DMK crc
+	if (pDrive->format == FORMAT_DMK)
+	{
+		sector_read(pSlot, pSector, size, buf, 2);
+		if (dmk_sector_crc(pSlot, pSector) != ((buf[0] << 8) | buf[1]))
+			status |= FDC_STATUS_CRC_ERROR;
+	}
+
+	FdcResultPort = status;
+	FdcCountLoPort = size & 0xFF;
+	FdcCountHiPort = size >> 8;
+	FdcControlPort = FDC_CONTROL_START;
+}
+
+static void read_address(TRACKSLOT* pSlot)
+{
+	if (pSlot->sectorCount == 0)
+	{
+		fdc_complete(FDC_STATUS_RNF);
+		return;
+	}
+
+	// Rotate through the sectors on the track
+	if (pSlot->nextAddress >= pSlot->sectorCount)
+		pSlot->nextAddress = 0;
+	SECTOR* pSector = &pSlot->sectors[pSlot->nextAddress++];
+
+	uint8_t id[7];
+	id[0] = 0xFE;
+	id[1] = pSector->idTrack;
+	id[2] = pSector->idSide;
+	id[3] = pSector->idSector;
+	id[4] = pSector->sizeCode;
+	uint16_t crc = crc16_update(0xFFFF, id, 5);
+	id[5] = crc >> 8;
+	id[6] = crc & 0xFF;
+
+	FdcResetBufferPort = 0;
+	fdc_write_buffer(id + 1, 6);
+	FdcResultPort = 0;
+	FdcCountLoPort = 6;
+	FdcCountHiPort = 0;
+	FdcControlPort = FDC_CONTROL_START;
+}
+
+// Parse a chunk of a write track data stream, writing the data for any
+// sectors that already exist in the cached track.  (Formatting with a
+// different sector layout isn't supported).
+static void parse_write_track(const uint8_t* p, uint8_t length)
+{
+	while (length)
+	{
+		switch (g_fmtState)
+		{
+			case FMT_SCAN:
+				if (*p == 0xFE)
+				{
+					g_fmtState = FMT_ID;
+					g_fmtIdPos = 0;
+				}
+				else if (*p >= 0xF8 && *p <= 0xFB && g_fmtHaveId)
+				{
+					g_pFmtSector = find_sector(g_pWriteSlot, g_fmtId[0], g_fmtId[2]);
+					if (!g_pFmtSector || g_pFmtSector->sizeCode != (g_fmtId[3] & 3))
+					{
+						g_pFmtSector = NULL;
+						g_fmtError = true;
+					}
+					g_fmtDam = 0xFB - *p;
+					g_fmtPos = 0;
+					g_fmtRemaining = sector_size(g_fmtId[3]);
+					g_fmtHaveId = false;
+					g_fmtState = FMT_DATA;
+				}
+				p++;
+				length--;
+				break;
+
+			case FMT_ID:
+				g_fmtId[g_fmtIdPos++] = *p++;
+				length--;
+				if (g_fmtIdPos == 4)
+				{
+					g_fmtHaveId = true;
+					g_fmtState = FMT_SCAN;
+				}
+				break;
+
+			case FMT_DATA:
+			{
+				uint8_t run = g_fmtRemaining > length ? length : (uint8_t)g_fmtRemaining;
+				if (g_pFmtSector)
+					sector_write(g_pWriteSlot, g_pFmtSector, g_fmtPos, p, run);
+				p += run;
+				length -= run;
+				g_fmtPos += run;
+				g_fmtRemaining -= run;
+				if (g_fmtRemaining == 0)
+				{
+					if (g_pFmtSector)
+						finish_sector_write(g_pWriteSlot, g_pFmtSector, g_fmtDam);
+					g_fmtState = FMT_SCAN;
+				}
+				break;
+			}
+		}
+	}
+}
+
+static void start_write_track_chunk()
+{
+	uint16_t remaining = WRITE_TRACK_BYTES - g_writeTrackBytes;
+	fdc_start_transfer(remaining > 1024 ? 1024 : remaining);
+}
+
+// Handle a new type II/III command
+static void service_command()
+{
+	uint8_t cmd = FdcCommandPort;
+	uint8_t drive = selected_drive();
+	if (drive == 0xFF || !g_drives[drive].pFile)
+	{
+		fdc_complete(FDC_STATUS_NOT_READY);
+		return;
+	}
+
+	trace_2(TRACE_FDC_COMMAND, (cmd << 8) | drive, (FdcTrackPort << 8) | FdcSectorPort);
+
+	TRACKSLOT* pSlot = get_track(drive, FdcPhysTrackPort, 0);
+
+	switch (cmd & 0xF0)
+	{
+		case 0x80:
+		case 0x90:
+		{
+			// Read sector
+			SECTOR* pSector = find_sector(pSlot, FdcTrackPort, FdcSectorPort);
+			if (pSector)
+				read_sector(pSlot, pSector);
+			else
+				fdc_complete(FDC_STATUS_RNF);
+			break;
+		}
+
+		case 0xA0:
+		case 0xB0:
+		{
+			// Write sector (phase 1 - accept data from TRS-80)
+			SECTOR* pSector = find_sector(pSlot, FdcTrackPort, FdcSectorPort);
+			if (pSector)
+			{
+				g_pWriteSlot = pSlot;
+				g_pWriteSector = pSector;
+				fdc_start_transfer(sector_size(pSector->sizeCode));
+			}
+			else
+			{
+				fdc_complete(FDC_STATUS_RNF);
+			}
+			break;
+		}
+
+		case 0xC0:
+			read_address(pSlot);
+			break;
+
+		case 0xF0:
+			// Write track
+			g_pWriteSlot = pSlot;
+			g_writeTrackBytes = 0;
+			g_fmtState = FMT_SCAN;
+			g_fmtHaveId = false;
+			g_fmtError = false;
+			start_write_track_chunk();
+			break;
+
+		default:
+			// Read track isn't supported
+			fdc_complete(FDC_STATUS_RNF);
+			break;
+	}
+}
+
+// Handle data written by the TRS-80 for write sector/track
+static void service_write_data()
+{
+	uint8_t cmd = FdcCommandPort;
+	uint8_t buf[64];
+
+	FdcResetBufferPort = 0;
+
+	if ((cmd & 0xF0) == 0xF0)
+	{
+		// Write track
+		uint16_t count = WRITE_TRACK_BYTES - g_writeTrackBytes;
+		if (count > 1024)
+			count = 1024;
+
+		for (uint16_t pos = 0; pos < count; pos += sizeof(buf))
+		{
+			uint8_t chunk = count - pos > sizeof(buf) ? sizeof(buf) : (uint8_t)(count - pos);
+			fdc_read_buffer(buf, chunk);
+			parse_write_track(buf, chunk);
+		}
+
+		g_writeTrackBytes += count;
+		if (g_writeTrackBytes < WRITE_TRACK_BYTES)
+			start_write_track_chunk();
+		else
+			fdc_complete(g_fmtError ? FDC_STATUS_WRITE_FAULT : 0);
+		return;
+	}
+
+	// Write sector
+	uint16_t size = sector_size(g_pWriteSector->sizeCode);
+	for (uint16_t pos = 0; pos < size; pos += sizeof(buf))
+	{
+		fdc_read_buffer(buf, sizeof(buf));
+		sector_write(g_pWriteSlot, g_pWriteSector, pos, buf, sizeof(buf));
+	}
+
+	// Data address mark comes from the low bits of the command
+	finish_sector_write(g_pWriteSlot, g_pWriteSector, cmd & 0x03);
+
+	fdc_complete(0);
+}
+
+static void update_drives_port()
+{
+	uint8_t present = 0;
+	uint8_t wp = 0;
+	for (uint8_t i=0; i<DISK_DRIVES; i++)
+	{
+		if (g_drives[i].pFile)
+		{
+			present |= 1 << i;
+			if (g_drives[i].writeProtect)
+				wp |= 1 << i;
+		}
+	}
+	FdcDrivesPort = (wp << 4) | present;
+}
+
+static bool is_dmk_header(const uint8_t* hdr)
+{
+	if (hdr[0] != 0x00 && hdr[0] != 0xFF)
+		return false;
+	if (hdr[1] == 0 || hdr[1] > 96)
+		return false;
+	for (uint8_t i=5; i<12; i++)
+	{
+		if (hdr[i] != 0)
+			return false;
+	}
+	uint16_t trackLength = hdr[2] | (hdr[3] << 8);
+	return trackLength > DMK_IDAM_TABLE_SIZE;
+}
+
+// Mount a disk image
+bool disk_mount(uint8_t drive, const char* pszFile)
+{
+	disk_eject(drive);
+
+	DRIVE* pDrive = &g_drives[drive];
+	FIL* pFile = (FIL*)malloc(sizeof(FIL));
+	bool writeProtect = false;
+	if (f_open(pFile, pszFile, FA_OPEN_EXISTING | FA_READ | FA_WRITE))
+	{
+		writeProtect = true;
+		if (f_open(pFile, pszFile, FA_OPEN_EXISTING | FA_READ))
+		{
+			free(pFile);
+			return false;
+		}
+	}
+
+	uint8_t hdr[DMK_HEADER_SIZE];
+	UINT bytes_read = 0;
+	memset(hdr, 0, sizeof(hdr));
+	f_read(pFile, hdr, sizeof(hdr), &bytes_read);
+	FSIZE_t size = f_size(pFile);
+
+	if (is_dmk_header(hdr))
+	{
+		pDrive->format = FORMAT_DMK;
+		pDrive->tracks = hdr[1];
+		pDrive->dmkTrackLength = hdr[2] | (hdr[3] << 8);
+		pDrive->dmkOptions = hdr[4];
+		pDrive->sides = (hdr[4] & DMK_OPT_SINGLE_SIDED) ? 1 : 2;
+		if (hdr[0] == 0xFF)
+			writeProtect = true;
+
+		if (pDrive->dmkTrackLength > TRACK_SLOT_SIZE)
+			goto fail;
+	}
+	else if (size % JV1_TRACK_SIZE == 0)
+	{
+		pDrive->format = FORMAT_JV1;
+		pDrive->tracks = size / JV1_TRACK_SIZE;
+		pDrive->sides = 1;
+	}
+	else if (size >= JV3_HEADER_SIZE)
+	{
+		pDrive->format = FORMAT_JV3;
+		pDrive->sides = 2;
+
+		// Load the sector header into banked memory
+		pDrive->jv3HeaderBank = bank_alloc(JV3_HEADER_BANKS);
+		if (!pDrive->jv3HeaderBank)
+			goto fail;
+
+		uint8_t buf[128];
+		f_lseek(pFile, 0);
+		for (uint16_t pos = 0; pos < JV3_HEADER_SIZE; pos += sizeof(buf))
+		{
+			UINT chunk = JV3_HEADER_SIZE - pos > sizeof(buf) ? sizeof(buf) : JV3_HEADER_SIZE - pos;
+			f_read(pFile, buf, chunk, &bytes_read);
+			bank_write(pDrive->jv3HeaderBank, pos, buf, chunk);
+		}
+
+		// Last byte of header is write enable flag
+		if (buf[(JV3_HEADER_SIZE - 1) % sizeof(buf)] == 0)
+			writeProtect = true;
+	}
+	else
+	{
+		goto fail;
+	}
+
+	pDrive->pFile = pFile;
+	pDrive->writeProtect = writeProtect;
+	update_drives_port();
+	return true;
+
+fail:
+	if (pDrive->jv3HeaderBank)
+	{
+		bank_free(pDrive->jv3HeaderBank, JV3_HEADER_BANKS);
+		pDrive->jv3HeaderBank = 0;
+	}
+	f_close(pFile);
+	free(pFile);
+	pDrive->format = FORMAT_NONE;
+	return false;
+}
+
+// Eject a disk image, writing back any dirty tracks
+void disk_eject(uint8_t drive)
+{
+	DRIVE* pDrive = &g_drives[drive];
+	if (!pDrive->pFile)
+		return;
+
+	for (uint8_t i=0; i<TRACK_SLOTS; i++)
+	{
+		TRACKSLOT* pSlot = &g_slots[i];
+		if (pSlot->drive == drive)
+		{
+			flush_slot(pSlot);
+			pSlot->drive = 0xFF;
+		}
+	}
+
+	if (pDrive->jv3HeaderBank)
+		bank_free(pDrive->jv3HeaderBank, JV3_HEADER_BANKS);
+
+	f_close(pDrive->pFile);
+	free(pDrive->pFile);
+	memset(pDrive, 0, sizeof(DRIVE));
+
+	update_drives_port();
+}
+
+// Write back all dirty tracks
+void disk_flush()
+{
+	for (uint8_t i=0; i<TRACK_SLOTS; i++)
+		flush_slot(&g_slots[i]);
+}
+
+void disk_fiber_proc()
+{
+	uart_write_sz("disk_fiber_proc()\n");
+
+	while (true)
+	{
+		// Wait for signal
+		wait_signal(&g_sig_fdc);
+
+		// Handle it
+		uint8_t phase = FdcPhasePort;
+		switch (phase & FDC_PHASE_MASK)
+		{
+			case FDC_PHASE_COMMAND:
+				service_command();
+				break;
+
+			case FDC_PHASE_WRITE_DATA:
+				service_write_data();
+				break;
+		}
+
+		// Drives have gone idle, write back
+		if (phase & FDC_PHASE_MOTOR_STOPPED)
+		{
+			FdcControlPort = FDC_CONTROL_MOTOR_ACK;
+			disk_flush();
+		}
+	}
+}
+
+void disk_init()
+{
+	for (uint8_t i=0; i<TRACK_SLOTS; i++)
+		g_slots[i].drive = 0xFF;
+
+	// Allocate the track cache
+	g_slotBank = bank_alloc(TRACK_SLOTS * TRACK_SLOT_BANKS);
+	if (!g_slotBank)
+	{
+		uart_write_sz("disk_init: no banks for track cache\n");
+		return;
+	}
+
+	// Mount disks from config
+	for (uint8_t i=0; i<DISK_DRIVES; i++)
+	{
+		if (g_pszDiskFile[i] && !disk_mount(i, g_pszDiskFile[i]))
+		{
+			sprintf(g_szTemp, "disk_init: failed to mount %s\n", g_pszDiskFile[i]);
+			uart_write_sz(g_szTemp);
+		}
+	}
+
+	init_signal(&g_sig_fdc);
+	create_fiber(disk_fiber_proc, 1024);
+}
+
+void disk_isr()
+{
+	if (InterruptControllerPort & IRQ_FDC)
+		set_signal(&g_sig_fdc);
+}
@@ -1,7 +1,39 @@
-#include <libSysCon.h>
-#include <ff.h>
+#include "syscon.h"
 #include <diskio.h>
-#include <stdio.h>
+
+// Sector cache
+//
+// FAT and directory sectors (anything FatFS reads through its window
+// buffer) are pinned in preference to file data.  Writes are held in the
+// cache until evicted or until FatFS issues CTRL_SYNC (ie: f_sync/f_close).
+// Multi-sector transfers go straight to the card.
+#define CACHE_BANKS			16
+#define CACHE_SECTORS		(CACHE_BANKS * 2)
+
+#define CACHE_VALID			0x01
+#define CACHE_DIRTY			0x02
+#define CACHE_PINNED		0x04
+
+typedef struct tagCACHEENTRY
+{
+	LBA_t sector;
+	uint16_t lastUsed;
+	uint8_t flags;
+} CACHEENTRY;
+
+extern FATFS g_fs;
+
+static CACHEENTRY g_cache[CACHE_SECTORS];
+static uint8_t g_cacheBank = 0;
+static uint16_t g_cacheClock = 0;
+static BYTE g_bounce[512];
+
+// only one drive, so only one mutex needed
+MUTEX g_mutexSync;
+
+uint32_t g_diskCacheHits = 0;
+uint32_t g_diskCacheMisses = 0;
+uint32_t g_diskCacheWriteBacks = 0;
 
 DSTATUS disk_initialize (BYTE pdrv)
 {
@@ -17,44 +49,243 @@ DSTATUS disk_status (BYTE pdrv)
     return (SdStatusPort & SD_STATUS_INIT) ? 0 : STA_NODISK;
 }
 
-extern char g_szTemp[];
+// Copy 512 bytes with unrolled LDIs (about 16.6 T-states per byte vs 21
+// for the LDIR in memcpy)
+static void copy_512(void* dst, const void* src) __naked
+{
+	dst; src;
+__asm
+		ld	hl, #2
+		add hl,sp
+		ld	e,(hl)
+		inc	hl
+		ld	d,(hl)
+		inc	hl
+		ld	a,(hl)
+		inc	hl
+		ld	h,(hl)
+		ld	l,a
+
+		ld	bc,#512
+10$:
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		ldi
+		jp	pe,10$
+		ret
+__endasm;
+}
+
+// Copy a sector between syscon RAM and a cache entry.  The SD card is
+// never accessed while the bank is mapped since sd_read/sd_write may
+// yield to other fibers.
+static void cache_copy(CACHEENTRY* pEntry, BYTE* buff, bool toCache)
+{
+	uint8_t index = pEntry - g_cache;
+	uint16_t save = bank_map(g_cacheBank + (index >> 1));
+	BYTE* pSector = (BYTE*)banked_page + ((index & 1) ? 512 : 0);
+	if (toCache)
+		copy_512(pSector, buff);
+	else
+		copy_512(buff, pSector);
+	bank_unmap(save);
+}
+
+static void cache_write_back(CACHEENTRY* pEntry)
+{
+	if (!(pEntry->flags & CACHE_DIRTY))
+		return;
+	cache_copy(pEntry, g_bounce, false);
+	sd_write(pEntry->sector, g_bounce);
+	pEntry->flags &= ~CACHE_DIRTY;
+	g_diskCacheWriteBacks++;
+}
+
+static bool cache_available()
+{
+	if (!g_cacheBank)
+		g_cacheBank = bank_alloc(CACHE_BANKS);
+	return g_cacheBank != 0;
+}
+
+static CACHEENTRY* cache_find(LBA_t sector)
+{
+	for (uint8_t i=0; i<CACHE_SECTORS; i++)
+	{
+		CACHEENTRY* pEntry = &g_cache[i];
+		if ((pEntry->flags & CACHE_VALID) && pEntry->sector == sector)
+		{
+			pEntry->lastUsed = ++g_cacheClock;
+			return pEntry;
+		}
+	}
+	return NULL;
+}
+
+// Find an entry to re-use (least recently used, preferring unpinned entries)
+static CACHEENTRY* cache_evict(LBA_t sector, bool pinned)
+{
+	CACHEENTRY* pBest = NULL;
+	for (uint8_t i=0; i<CACHE_SECTORS; i++)
+	{
+		CACHEENTRY* pEntry = &g_cache[i];
+		if (!(pEntry->flags & CACHE_VALID))
+		{
+			pBest = pEntry;
+			break;
+		}
+
+		if (pBest == NULL)
+		{
+			pBest = pEntry;
+			continue;
+		}
+
+		bool bestPinned = (pBest->flags & CACHE_PINNED) != 0;
+		bool entryPinned = (pEntry->flags & CACHE_PINNED) != 0;
+		if (bestPinned != entryPinned)
+		{
+			if (bestPinned)
+				pBest = pEntry;
+			continue;
+		}
+
+		if ((uint16_t)(g_cacheClock - pEntry->lastUsed) > (uint16_t)(g_cacheClock - pBest->lastUsed))
+			pBest = pEntry;
+	}
+
+	cache_write_back(pBest);
+	pBest->sector = sector;
+	pBest->flags = CACHE_VALID | (pinned ? CACHE_PINNED : 0);
+	pBest->lastUsed = ++g_cacheClock;
+	return pBest;
+}
+
+// Write back (and optionally discard) cached sectors in a range
+static void cache_flush_range(LBA_t sector, UINT count, bool discard)
+{
+	for (uint8_t i=0; i<CACHE_SECTORS; i++)
+	{
+		CACHEENTRY* pEntry = &g_cache[i];
+		if ((pEntry->flags & CACHE_VALID) && pEntry->sector >= sector && pEntry->sector < sector + count)
+		{
+			if (discard)
+				pEntry->flags = 0;
+			else
+				cache_write_back(pEntry);
+		}
+	}
+}
+
+static bool is_banked(const BYTE* buff)
+{
+	return buff >= (const BYTE*)banked_page && buff < (const BYTE*)banked_page + sizeof(banked_page);
+}
+
+// Write back all dirty sectors
+static void cache_sync()
+{
+	for (uint8_t i=0; i<CACHE_SECTORS; i++)
+		cache_write_back(&g_cache[i]);
+}
+
+// Discard a cached sector, including any unwritten changes.  Used before
+// the cassette hardware reads or writes a sector directly on the card.
+// Called from outside FatFS so takes the volume lock itself.
+void disk_cache_invalidate(LBA_t sector)
+{
+	ff_req_grant(&g_mutexSync);
+	cache_flush_range(sector, 1, true);
+	ff_rel_grant(&g_mutexSync);
+}
+
+// Write back all dirty sectors (eg: before a reset).  Called from outside
+// FatFS so takes the volume lock, otherwise a fiber blocked part way
+// through a FatFS call could have the cache changed underneath it.
+void disk_cache_sync()
+{
+	ff_req_grant(&g_mutexSync);
+	cache_sync();
+	ff_rel_grant(&g_mutexSync);
+}
 
 DRESULT disk_read (BYTE pdrv, BYTE* buff, LBA_t sector, UINT count)
 {
-//    sprintf(g_szTemp, "disk_read(%i)\n", (int)sector);
-//    uart_write_sz(g_szTemp);
+    // Multi-sector reads go direct to the card
+    if (count > 1 || is_banked(buff) || !cache_available())
+    {
+        cache_flush_range(sector, count, false);
+        while (count)
+        {
+            sd_read(sector++, buff);
+            buff += 512;
+            count--;
+        }
+        return 0;
+    }
 
-    while (count)
+    // Cache hit?
+    CACHEENTRY* pEntry = cache_find(sector);
+    if (pEntry)
     {
-        sd_read(sector++, buff);
-        buff += 512;
-        count--;
+        g_diskCacheHits++;
+        cache_copy(pEntry, buff, false);
+        return 0;
     }
 
+    // Miss
+    g_diskCacheMisses++;
+    sd_read(sector, buff);
+    pEntry = cache_evict(sector, buff == g_fs.win);
+    cache_copy(pEntry, buff, true);
 	return 0;
 }
 
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count)
 {
-//    sprintf(g_szTemp, "disk_write(%i)\n", (int)sector);
-//    uart_write_sz(g_szTemp);
-
-    while (count)
+    // Multi-sector writes go direct to the card
+    if (count > 1 || is_banked(buff) || !cache_available())
     {
-        sd_write(sector++, buff);
-        buff += 512;
-        count--;
+        cache_flush_range(sector, count, true);
+        while (count)
+        {
+            sd_write(sector++, buff);
+            buff += 512;
+            count--;
+        }
+        return 0;
     }
+
+    // Update the cache, write back later
+    CACHEENTRY* pEntry = cache_find(sector);
+    if (!pEntry)
+        pEntry = cache_evict(sector, buff == g_fs.win);
+    cache_copy(pEntry, (BYTE*)buff, true);
+    pEntry->flags |= CACHE_DIRTY;
 	return 0;
 }
 
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
 {
+    // FatFS already holds the volume lock
+    if (cmd == CTRL_SYNC)
+        cache_sync();
 	return 0;
 }
 
-// only one drive, so only one mutex needed
-MUTEX g_mutexSync;
 
 int ff_cre_syncobj (	/* 1:Function succeeded, 0:Could not create the sync object */
 	BYTE vol,			/* Corresponding volume (logical drive number) */
@@ -0,0 +1,104 @@
+#include "syscon.h"
+
+#define DISK_NAME_WIDTH		22
+
+static char item_text[DISK_DRIVES][DISK_NAME_WIDTH + 6];
+
+static char* items[] = {
+	item_text[0],
+	item_text[1],
+	item_text[2],
+	item_text[3],
+	NULL
+};
+
+static void update_item(uint8_t drive)
+{
+	const char* pszFile = g_pszDiskFile[drive];
+	if (!pszFile)
+		pszFile = "(empty)";
+
+	// Show the end of long names
+	size_t len = strlen(pszFile);
+	if (len > DISK_NAME_WIDTH)
+		pszFile += len - DISK_NAME_WIDTH;
+
+	sprintf(item_text[drive], ":%i  %s", (int)drive, pszFile);
+}
+
+static void invoke_command(LISTBOX* pListBox)
+{
+	uint8_t drive = pListBox->selectedItem;
+
+	const char* pszFile = choose_file("*.dsk", g_pszDiskFile[drive], "(eject)");
+	if (!pszFile)
+		return;
+
+	// Eject?
+	if (pszFile[0] == '\0')
+	{
+		free(pszFile);
+		pszFile = NULL;
+		disk_eject(drive);
+	}
+	else if (!disk_mount(drive, pszFile))
+	{
+		message_box("Mount Disk", "Failed!", okButtons, MB_ERROR);
+		free(pszFile);
+		return;
+	}
+
+	if (g_pszDiskFile[drive])
+		free(g_pszDiskFile[drive]);
+	g_pszDiskFile[drive] = pszFile;
+
+	update_item(drive);
+	listbox_drawitem(pListBox, pListBox->selectedItem);
+	config_save();
+}
+
+size_t disks_menu_proc(WINDOW* pWindow, MSG* pMsg)
+{
+	switch (pMsg->message)
+	{
+		case MESSAGE_KEYDOWN:
+		{
+			switch (pMsg->param1)
+			{
+				case KEY_ESCAPE:
+					window_end_modal(0);
+					return 0;
+
+				case KEY_ENTER:
+                    invoke_command((LISTBOX*)pWindow);
+					return 0;
+			}
+			break;
+		}
+	}
+
+	return listbox_wndproc(pWindow, pMsg);
+}
+
+void disks_menu()
+{
+	for (uint8_t i=0; i<DISK_DRIVES; i++)
+		update_item(i);
+
+	LISTBOX lb;
+	memset(&lb, 0, sizeof(LISTBOX));
+
+	lb.window.rcFrame.left = 2;
+	lb.window.rcFrame.top = 1;
+	lb.window.rcFrame.width = DISK_NAME_WIDTH + 8;
+	lb.window.rcFrame.height = DISK_DRIVES + 2;
+	lb.window.attrNormal = MAKECOLOR(COLOR_WHITE, COLOR_BLUE);
+	lb.window.attrSelected = MAKECOLOR(COLOR_BLACK, COLOR_YELLOW);
+	lb.window.title = "Disks";
+	lb.window.wndProc = disks_menu_proc;
+	lb.selectedItem = 0;
+    listbox_set_data(&lb, -1, items);
+
+	window_run_modal(&lb.window);
+
+}
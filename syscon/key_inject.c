@@ -0,0 +1,114 @@
+#include "syscon.h"
+
+// Types text into the TRS-80 by injecting keys into the keyboard matrix
+// (see Trs80KeyInjector.vhd).  Each key is held until the TRS-80 has
+// completed a full keyboard scan and then released for another full scan
+// so repeated characters register.  No fixed delays are used so typing
+// runs as fast as the TRS-80 software reads the keyboard.
+
+#define KEY_SHIFT		0x80
+#define KEY_NONE		0xFF
+#define KEY_ENTER		48
+#define KEY_SHIFT_ROW	7
+
+static SIGNAL g_sig_keyscan;
+
+// Key codes (row * 8 + bit, KEY_SHIFT if shifted) for characters 0x20 - 0x3F
+static const uint8_t key_codes[] = {
+	55,						// space
+	KEY_SHIFT | 33,			// !
+	KEY_SHIFT | 34,			// "
+	KEY_SHIFT | 35,			// #
+	KEY_SHIFT | 36,			// $
+	KEY_SHIFT | 37,			// %
+	KEY_SHIFT | 38,			// &
+	KEY_SHIFT | 39,			// '
+	KEY_SHIFT | 40,			// (
+	KEY_SHIFT | 41,			// )
+	KEY_SHIFT | 42,			// *
+	KEY_SHIFT | 43,			// +
+	44,						// ,
+	45,						// -
+	46,						// .
+	47,						// /
+	32, 33, 34, 35, 36, 37, 38, 39,		// 0 - 7
+	40,						// 8
+	41,						// 9
+	42,						// :
+	43,						// ;
+	KEY_SHIFT | 44,			// <
+	KEY_SHIFT | 45,			// =
+	KEY_SHIFT | 46,			// >
+	KEY_SHIFT | 47,			// ?
+};
+
+static uint8_t key_for_char(char ch)
+{
+	if (ch == '\n')
+		return KEY_ENTER;
+	if (ch >= 'a' && ch <= 'z')
+		ch -= 'a' - 'A';
+	if (ch >= '@' && ch <= 'Z')
+		return ch - '@';
+	if (ch >= ' ' && ch <= '?')
+		return key_codes[ch - ' '];
+	return KEY_NONE;
+}
+
+// Set the injected bits for a keyboard row
+static void key_inject_row(uint8_t row, uint8_t bits) __naked
+{
+	row; bits;
+__asm
+		ld	hl, #2
+		add hl, sp
+		ld	a, (hl)
+		add	a, #KEY_INJECT_ROW_PORT
+		ld	c, a
+		inc	hl
+		ld	a, (hl)
+		out	(c), a
+		ret
+__endasm;
+}
+
+// Wait for the TRS-80 to start a number of keyboard scans
+static void wait_scans(uint8_t count)
+{
+	KeyInjectScanPort = count;
+	wait_signal(&g_sig_keyscan);
+	KeyInjectScanPort = 0;
+}
+
+// Type a single character (must be called from a fiber)
+void key_type_char(char ch)
+{
+	uint8_t key = key_for_char(ch);
+	if (key == KEY_NONE)
+		return;
+
+	// Press
+	if (key & KEY_SHIFT)
+		key_inject_row(KEY_SHIFT_ROW, 0x01);
+	key_inject_row((key >> 3) & 0x07, 1 << (key & 0x07));
+
+	// Two scan starts guarantees one complete scan saw the key
+	wait_scans(2);
+
+	// Release
+	KeyInjectReleasePort = 0;
+	wait_scans(2);
+}
+
+void key_inject_init()
+{
+	init_signal(&g_sig_keyscan);
+	KeyInjectReleasePort = 0;
+	KeyInjectScanPort = 0;
+}
+
+void key_inject_isr()
+{
+	if (InterruptControllerPort & IRQ_KEY_INJECT)
+		set_signal(&g_sig_keyscan);
+}
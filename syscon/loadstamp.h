@@ -0,0 +1,25 @@
+#ifndef _LOADSTAMP_H
+#define _LOADSTAMP_H
+
+#include <stdint.h>
+
+// Load stamps are kept in the last bank of external RAM and record what's
+// been loaded so a warm reset can skip re-reading images from the SD card.
+// Shared by the syscon and the boot ROM.
+#define BANK_STAMPS			255
+#define STAMP_SIGNATURE		0xB1805747UL
+#define STAMP_SYSCON		0
+#define STAMP_LEVEL2		1
+
+typedef struct tagLOADSTAMP
+{
+    uint32_t signature;
+    uint32_t size;
+    uint16_t fdate;
+    uint16_t ftime;
+    uint32_t crc;
+    uint8_t firstBank;
+    uint8_t reserved[15];
+} LOADSTAMP;
+
+#endif
@@ -31,38 +31,55 @@ void main(void)
     // Load config
     config_load();
 
-    // Open big80.sys
-    FIL* pf = (FIL*)malloc(sizeof(FIL));
-    uart_write_sz("Opening level2-a.rom...");
-    r = f_open(pf, "0:/level2-a.rom", FA_OPEN_EXISTING | FA_READ);
-    if (r != 0)
+    // Already loaded? (warm reset).  The fast save patch is reapplied
+    // by cassette_init.
+    cassette_unpatch_rom();
+    FILINFO fi;
+    FRESULT rStat = f_stat("0:/level2-a.rom", &fi);
+    if (rStat == 0 && bank_is_resident(STAMP_LEVEL2, 0, &fi))
     {
-        free(pf);
-        sprintf(g_szTemp, " FAILED (%i)\n", r);
-        uart_write_sz(g_szTemp);
-        return;
+        uart_write_sz("level2-a.rom already resident.\n");
     }
-    uart_write_sz(" OK\n");
-
-    // Map page bank to trs80 ram area (bank 0)
-    ApmEnable = APM_ENABLE_PAGEBANK;
-    ApmPageBank = 0;
-    uint16_t totalBytes = 0;
-    while (1)
+    else
     {
-        UINT bytes_read = 0;
-        f_read(pf, (BYTE*)banked_page, sizeof(banked_page), &bytes_read);
-        totalBytes += bytes_read;
-        ApmPageBank++;
-        if (bytes_read != sizeof(banked_page))
-            break;
-    }
-    f_close(pf);
-    free(pf);
-    ApmEnable = 0;   
+        // Open level2-a.rom
+        FIL* pf = (FIL*)malloc(sizeof(FIL));
+        uart_write_sz("Opening level2-a.rom...");
+        r = f_open(pf, "0:/level2-a.rom", FA_OPEN_EXISTING | FA_READ);
+        if (r != 0)
+        {
+            free(pf);
+            sprintf(g_szTemp, " FAILED (%i)\n", r);
+            uart_write_sz(g_szTemp);
+            return;
+        }
+        uart_write_sz(" OK\n");
+
+        // Map page bank to trs80 ram area (bank 0)
+        ApmEnable = APM_ENABLE_PAGEBANK;
+        ApmPageBank = 0;
+        uint16_t totalBytes = 0;
+        uint32_t crc = 0;
+        while (1)
+        {
+            UINT bytes_read = 0;
+            f_read(pf, (BYTE*)banked_page, sizeof(banked_page), &bytes_read);
+            crc = crc32_update(crc, banked_page, bytes_read);
+            totalBytes += bytes_read;
+            ApmPageBank++;
+            if (bytes_read != sizeof(banked_page))
+                break;
+        }
+        f_close(pf);
+        free(pf);
+        ApmEnable = 0;   
 
-    sprintf(g_szTemp, "level2-a.rom loaded (%u bytes).\n", totalBytes);
-    uart_write_sz(g_szTemp);
+        // Stamp it so a warm reset can skip loading
+        if (rStat == 0 && totalBytes == fi.fsize)
+            bank_write_stamp(STAMP_LEVEL2, 0, &fi, crc);
+
+        trace_1(TRACE_ROM_LOADED, totalBytes);
+    }
 
     uart_write_sz("Starting interrupt loop\n");
 
@@ -70,6 +87,8 @@ void main(void)
     sd_init_isr();
     msg_init();
     cassette_init();
+    disk_init();
+    key_inject_init();
 
     // Create the main UI Fiber
     create_fiber(ui_fiber_proc, 1024);
@@ -86,18 +105,25 @@ void main(void)
 //        sprintf(g_szTemp, "[%2x]", (int)InterruptControllerPort);
 //        uart_write_sz(g_szTemp);
 
-        // Process all interrupts
+        // Process all interrupts (cassette first, it has a deadline)
+        cassette_isr();
         uart_read_isr();
+        uart_fifo_isr();
         uart_write_isr();
         sd_isr();
         msg_isr();
-        cassette_isr();
+        disk_isr();
+        key_inject_isr();
     }
 
 }
 
 size_t window_proc_hook(WINDOW* pWindow, MSG* pMsg, bool* pbHandled)
 {
+    // Menus can run for a long time without yielding, keep preloaded tape
+    // playback fed
+    cassette_poll();
+
     if (pMsg->message == MESSAGE_KEYDOWN)
     {
         // Toggle video overlay and all keys on/off...
@@ -1,21 +1,25 @@
 #include "syscon.h"
 
 #define COMMAND_CHOOSETAPE	0
-#define COMMAND_SAVE_RECORDING 1
-#define COMMAND_PLAY 3
-#define COMMAND_RECORD 4
-#define COMMAND_STOP 5
-#define COMMAND_OPTIONS		7
-#define COMMAND_RESET		8
+#define COMMAND_CHOOSEPROGRAM	1
+#define COMMAND_SAVE_RECORDING 2
+#define COMMAND_PLAY 4
+#define COMMAND_RECORD 5
+#define COMMAND_STOP 6
+#define COMMAND_DISKS		8
+#define COMMAND_OPTIONS		9
+#define COMMAND_RESET		10
 
 static char* items[] = {
 	"Choose Tape...",
+	"Choose Program...",
 	"Save Recording...",
 	"\1",
 	"Play",
 	"Record",
 	"Stop",
 	"\1",
+	"Disks...",
 	"Options...",
 	"Reset",
 	NULL
@@ -39,15 +43,26 @@ bool copy_file(const char* pszFrom, const char* pszTo)
 		return false;
 	}
 
+	// Copy whole sectors at a time so FatFS transfers straight to/from
+	// the buffer instead of through its window
+	BYTE* buf = (BYTE*)malloc(512);
+	if (!buf)
+	{
+		f_close(&src);
+		f_close(&dst);
+		return false;
+	}
+
 	while (true)
 	{
 		UINT byteCount = 0;
-		f_read(&src, g_szTemp, sizeof(g_szTemp), &byteCount);
+		f_read(&src, buf, 512, &byteCount);
 		if (byteCount == 0)
 			break;	
-		f_write(&dst, g_szTemp, byteCount, &byteCount);
+		f_write(&dst, buf, byteCount, &byteCount);
 	}
 
+	free(buf);
 	f_close(&src);
 	f_close(&dst);
 	return true;
@@ -66,10 +81,19 @@ static void invoke_command(LISTBOX* pListBox)
 					free(g_pszCasFile);
 				g_pszCasFile = pszFile;
 				config_save();
+				cassette_preload();
+
+				// Multiple programs on the tape?
+				if (g_casIndexCount > 1)
+					tape_menu();
 			}
 			break;
 		}
 
+		case COMMAND_CHOOSEPROGRAM:
+			tape_menu();
+			break;
+
 		case COMMAND_SAVE_RECORDING:
 		{
 			const char* psz = prompt_input("Save As", g_pszCasSaveFile);
@@ -107,11 +131,17 @@ static void invoke_command(LISTBOX* pListBox)
 			HideUI();
 			break;
 
+		case COMMAND_DISKS:
+			disks_menu();
+			break;
+
 		case COMMAND_OPTIONS:
 			options_menu();
 			break;
 
 		case COMMAND_RESET:
+			disk_flush();
+			disk_cache_sync();
             ApmEnable |= APM_ENABLE_RESET;
 			break;
 	}
@@ -150,7 +180,7 @@ void main_menu()
 	lb.window.rcFrame.left = 0;
 	lb.window.rcFrame.top = 0;
 	lb.window.rcFrame.width = 22;
-	lb.window.rcFrame.height = 11;
+	lb.window.rcFrame.height = 13;
 	lb.window.attrNormal = MAKECOLOR(COLOR_WHITE, COLOR_BLUE);
 	lb.window.attrSelected = MAKECOLOR(COLOR_BLACK, COLOR_YELLOW);
 	lb.window.title = "Big80 v2.0";
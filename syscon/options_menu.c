@@ -6,6 +6,9 @@
 #define COMMAND_TURBO_TAPE		3
 #define COMMAND_TAPE_AUDIO		4
 #define COMMAND_TYPING_MODE		5
+#define COMMAND_CPU_SPEED		6
+#define COMMAND_AUTO_TURBO		7
+#define COMMAND_FAST_SAVE		8
 
 static char* items[] = {
 	"Screen Color      Green",
@@ -14,6 +17,9 @@ static char* items[] = {
 	"Turbo Tape          Yes",
 	"Tape Audio Monitor  Yes",
 	"Typing Mode         Yes",
+	"CPU Speed       1.77Mhz",
+	"Auto Turbo          Yes",
+	"Fast Save           Yes",
 	NULL
 };
 
@@ -27,8 +33,47 @@ static void update_option(char* psz, bool val)
 		strcpy(psz + strlen(psz) - 3, val ? "Yes" : " No");
 }
 
+static const char* speed_names[] = {
+	"1.77Mhz",
+	" 3.5Mhz",
+	"   7Mhz",
+	"  14Mhz",
+	"    Max",
+};
+
+static void update_speed_option(char* psz, uint8_t speed)
+{
+	speed &= SPEED_MASK;
+	if (speed > SPEED_MAX)
+		speed = SPEED_MAX;
+	strcpy(psz + strlen(psz) - 7, speed_names[speed]);
+}
+
 static void invoke_command(LISTBOX* pListBox)
 {
+	// Cycle through speed steps
+	if (pListBox->selectedItem == COMMAND_CPU_SPEED)
+	{
+		uint8_t speed = (SpeedPort & SPEED_MASK) + 1;
+		if (speed > SPEED_MAX)
+			speed = SPEED_1_77MHZ;
+		SpeedPort = (SpeedPort & ~SPEED_MASK) | speed;
+		update_speed_option(items[COMMAND_CPU_SPEED], SpeedPort);
+		listbox_drawitem(pListBox, pListBox->selectedItem);
+		config_save();
+		return;
+	}
+
+	// Toggle auto turbo
+	if (pListBox->selectedItem == COMMAND_AUTO_TURBO)
+	{
+		SpeedPort ^= SPEED_AUTO_TURBO;
+		update_option(items[COMMAND_AUTO_TURBO], SpeedPort & SPEED_AUTO_TURBO);
+		listbox_drawitem(pListBox, pListBox->selectedItem);
+		config_save();
+		return;
+	}
+
 	// Map command to bit
 	uint8_t bit = 0;
 	switch (pListBox->selectedItem)
@@ -39,11 +84,16 @@ static void invoke_command(LISTBOX* pListBox)
 		case COMMAND_TURBO_TAPE: bit = OPTION_TURBO_TAPE; break;
 		case COMMAND_TAPE_AUDIO: bit = OPTION_CAS_AUDIO; break;
 		case COMMAND_TYPING_MODE: bit = OPTION_TYPING_MODE; break;
+		case COMMAND_FAST_SAVE: bit = OPTION_FAST_SAVE; break;
 	}
 
 	// Toggle the bit
 	OptionsPort ^= bit;
 
+	// Fast save needs the ROM patched
+	if (bit == OPTION_FAST_SAVE)
+		cassette_patch_rom();
+
 	// Update command text
 	update_option(items[pListBox->selectedItem], OptionsPort & bit);
 
@@ -87,6 +137,9 @@ void options_menu()
 	update_option(items[COMMAND_TURBO_TAPE], OptionsPort & OPTION_TURBO_TAPE);
 	update_option(items[COMMAND_TAPE_AUDIO], OptionsPort & OPTION_CAS_AUDIO);
 	update_option(items[COMMAND_TYPING_MODE], OptionsPort & OPTION_TYPING_MODE);
+	update_speed_option(items[COMMAND_CPU_SPEED], SpeedPort);
+	update_option(items[COMMAND_AUTO_TURBO], SpeedPort & SPEED_AUTO_TURBO);
+	update_option(items[COMMAND_FAST_SAVE], OptionsPort & OPTION_FAST_SAVE);
 
 	LISTBOX lb;
 	memset(&lb, 0, sizeof(LISTBOX));
@@ -94,7 +147,7 @@ void options_menu()
 	lb.window.rcFrame.left = 2;
 	lb.window.rcFrame.top = 1;
 	lb.window.rcFrame.width = 25;
-	lb.window.rcFrame.height = 8;
+	lb.window.rcFrame.height = 12;
 	lb.window.attrNormal = MAKECOLOR(COLOR_WHITE, COLOR_BLUE);
 	lb.window.attrSelected = MAKECOLOR(COLOR_BLACK, COLOR_YELLOW);
 	lb.window.title = "Options";
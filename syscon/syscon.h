@@ -3,13 +3,119 @@
 #include <string.h>
 #include <libSysCon.h>
 #include <ff.h>
+#include "loadstamp.h"
 
 extern char g_szTemp[128];
 
+#ifndef APM_ENABLE_VIDEOBANK
+#define APM_ENABLE_VIDEOBANK	0x01
+#endif
+
+// Set when cassette playback has run out of data (see Trs80CassetteStreamer.vhd)
+#ifndef CASSETTE_STATUS_STALLED
+#define CASSETTE_STATUS_STALLED	0x08
+#endif
+
+// Supply the next playback block via the direct data port instead of
+// loading it from the SD card (see Trs80CassetteController.vhd)
+#define CASSETTE_DIRECT_PORT			0xC2
+#define CASSETTE_COMMAND_DIRECT_BLOCK	0x10
+
+// Fast save option.  Cassette bytes written by the ROM are captured 
+// directly instead of being recorded from the audio (see cassette_fiber.c)
+#define OPTION_FAST_SAVE		0x40
+
+// CPU speed profile port (see Trs80Model1Core.vhd)
+__sfr __at(0x01) SpeedPort;
+#define SPEED_MASK			0x07
+#define SPEED_1_77MHZ		0
+#define SPEED_3_5MHZ		1
+#define SPEED_7MHZ			2
+#define SPEED_14MHZ			3
+#define SPEED_MAX			4
+#define SPEED_AUTO_TURBO	0x08
+
+// Serial receive fifo ports (see SysConSerialRxFifo.vhd)
+__sfr __at(0x84) UartFifoDataPort;
+__sfr __at(0x85) UartFifoStatusPort;
+__sfr __at(0x86) UartFifoOverrunPort;
+__sfr __at(0x87) UartFifoErrorPort;
+#define UART_FIFO_STATUS_AVAILABLE		0x01
+#define UART_FIFO_STATUS_FULL			0x02
+#define UART_FIFO_STATUS_THROTTLED		0x04
+#define UART_FIFO_STATUS_ENABLED		0x80
+#define UART_FIFO_CONTROL_ENABLE		0x01
+#define UART_FIFO_CONTROL_CLEAR_ERRORS	0x02
+#define IRQ_UART_FIFO					0x20
+
+// Floppy disk controller service ports (see Trs80FloppyController.vhd)
+#define FDC_BUFFER_PORT			0xD6
+__sfr __at(0xD0) FdcCommandPort;		// read
+__sfr __at(0xD0) FdcResultPort;			// write
+__sfr __at(0xD1) FdcDriveSelectPort;	// read
+__sfr __at(0xD1) FdcCountLoPort;		// write
+__sfr __at(0xD2) FdcTrackPort;			// read
+__sfr __at(0xD2) FdcCountHiPort;		// write
+__sfr __at(0xD3) FdcSectorPort;			// read
+__sfr __at(0xD3) FdcControlPort;		// write
+__sfr __at(0xD4) FdcPhysTrackPort;		// read
+__sfr __at(0xD4) FdcDrivesPort;			// write
+__sfr __at(0xD5) FdcPhasePort;			// read
+__sfr __at(0xD5) FdcResetBufferPort;	// write
+__sfr __at(FDC_BUFFER_PORT) FdcBufferPort;
+__sfr __at(0xD7) FdcDataPort;
+#define FDC_PHASE_COMMAND		0x01
+#define FDC_PHASE_WRITE_DATA	0x02
+#define FDC_PHASE_MASK			0x03
+#define FDC_PHASE_MOTOR_STOPPED	0x04
+#define FDC_CONTROL_START		0x01
+#define FDC_CONTROL_COMPLETE	0x02
+#define FDC_CONTROL_MOTOR_ACK	0x04
+#define IRQ_FDC					0x40
+
+// Key injection ports (see Trs80KeyInjector.vhd)
+#define KEY_INJECT_ROW_PORT		0xE0
+__sfr __at(0xE8) KeyInjectScanPort;
+__sfr __at(0xE9) KeyInjectReleasePort;
+#define IRQ_KEY_INJECT			0x80
+
+// Performance counter ports (see SysConPerfCounters.vhd)
+__sfr __at(0xB0) PerfLatchPort;			// write
+__sfr __at(0xB0) PerfData0Port;			// read
+__sfr __at(0xB1) PerfData1Port;
+__sfr __at(0xB2) PerfData2Port;
+__sfr __at(0xB3) PerfData3Port;
+__sfr __at(0xB4) PerfSelectPort;
+#define PERF_CLOCK_CYCLES		0
+#define PERF_CPU_CYCLES			1
+#define PERF_RAM_WAIT_CYCLES	2
+#define PERF_HIJACKED_CYCLES	3
+#define PERF_SD_BUSY_CYCLES		4
+#define PERF_CAS_BLOCKS			5
+#define PERF_CAS_UNDERRUNS		6
+#define PERF_UART_OVERRUNS		7
+#define PERF_COUNTER_COUNT		8
+
+// Screen mirror ports (see Trs80Model1Core.vhd)
+__sfr __at(0xF0) ScreenRowPort;			// write
+__sfr __at(0xF0) ScreenDirtyLoPort;		// read
+__sfr __at(0xF1) ScreenDataPort;
+__sfr __at(0xF2) ScreenDirtyHiPort;
+#define SCREEN_MARKER			0x1D
+#define SCREEN_END				0xFF
+#define SCREEN_ROW_OVERLAY		0x10	// overlay row ids follow the TRS-80's 0-15
+#define SCREEN_FLAG_OVERLAY		0x01	// syscon overlay is being shown
+
 // uart_fiber.c
 void uart_interrupts();
 void uart_init();
 
+// uart_fifo.c
+void uart_fifo_init();
+void uart_fifo_isr();
+uint8_t uart_fifo_read(void* p, uint8_t length);
+void uart_fifo_read_wait(void* p, uint16_t length);
+
 // main_menu.c
 void main_menu();
 
@@ -21,7 +127,91 @@ void config_load();
 void config_save();
 
 // cassette_fiber.c
+#define CAS_INDEX_MAX		16
+
+typedef struct tagCASPROGRAM
+{
+	uint32_t offset;		// Start of the program's leader
+	char type;				// 'S' = SYSTEM, 'B' = BASIC
+	char name[7];
+} CASPROGRAM;
+
 extern const char* g_pszCasFile;
 extern const char* g_pszCasSaveFile;
+extern CASPROGRAM g_casIndex[CAS_INDEX_MAX];
+extern uint8_t g_casIndexCount;
+extern uint32_t g_casStartPos;
+extern uint16_t g_casLateBlocks;
 void cassette_init();
+void cassette_preload();
+void cassette_patch_rom();
+void cassette_unpatch_rom();
 void cassette_isr();
+bool cassette_poll();
+
+// tape_menu.c
+void tape_menu();
+
+// crc32_update.c, crc32.c
+uint32_t crc32_update(uint32_t crc, const void* p, uint16_t length);
+FRESULT crc32_file(const char* pszFileName, uint32_t* pCrc, uint32_t* pSize);
+
+// crc16.c
+uint16_t crc16_update(uint16_t crc, const void* p, uint16_t length);
+
+// banks.c
+#define BANK_FIRST_SPARE	128
+#define BANK_LAST_SPARE		254
+uint8_t bank_alloc(uint8_t count);
+void bank_free(uint8_t bank, uint8_t count);
+uint8_t bank_free_count();
+uint16_t bank_map(uint8_t bank);
+void bank_unmap(uint16_t save);
+void bank_read(uint8_t bank, uint16_t offset, void* dst, uint16_t length);
+void bank_write(uint8_t bank, uint16_t offset, const void* src, uint16_t length);
+
+// Load stamps (see loadstamp.h)
+bool bank_is_resident(uint8_t slot, uint8_t firstBank, FILINFO* pfi);
+void bank_write_stamp(uint8_t slot, uint8_t firstBank, FILINFO* pfi, uint32_t crc);
+
+// diskio.c
+extern uint32_t g_diskCacheHits;
+extern uint32_t g_diskCacheMisses;
+extern uint32_t g_diskCacheWriteBacks;
+void disk_cache_sync();
+void disk_cache_invalidate(LBA_t sector);
+
+// trace.c (event ids must match tools/bet/trace-events.js)
+#define TRACE_MARKER		0x1E
+#define TRACE_END			0		// end of log
+#define TRACE_DROPPED		1		// count
+#define TRACE_ROM_LOADED	2		// bytes
+#define TRACE_CAS_BLOCK		3		// pos (32), sector (32)
+#define TRACE_SPUSH			4		// received (32), size (32)
+#define TRACE_FDC_COMMAND	5		// cmd << 8 | drive, track << 8 | sector
+#define TRACE_FDC_LOAD		6		// drive, track
+#define TRACE_CAS_LATE		7		// pos (32), late count (32)
+#define TRACE_FDC_READ_ERROR	8		// drive, track
+#define TRACE_CAS_SAVED		9		// FatFS result, name suffix
+void trace_0(uint8_t id);
+void trace_1(uint8_t id, uint16_t a);
+void trace_2(uint8_t id, uint16_t a, uint16_t b);
+void trace_2l(uint8_t id, uint32_t a, uint32_t b);
+void trace_drain();
+
+// key_inject.c
+void key_inject_init();
+void key_inject_isr();
+void key_type_char(char ch);
+
+// disk_fiber.c
+#define DISK_DRIVES 4
+extern const char* g_pszDiskFile[DISK_DRIVES];
+void disk_init();
+void disk_isr();
+bool disk_mount(uint8_t drive, const char* pszFile);
+void disk_eject(uint8_t drive);
+void disk_flush();
+
+// disks_menu.c
+void disks_menu();
@@ -0,0 +1,70 @@
+#include "syscon.h"
+
+static char item_text[CAS_INDEX_MAX][16];
+static char* items[CAS_INDEX_MAX + 1];
+
+static void invoke_command(LISTBOX* pListBox)
+{
+	// Start playback at the selected program
+	g_casStartPos = g_casIndex[pListBox->selectedItem].offset;
+	window_end_modal(0);
+}
+
+size_t tape_menu_proc(WINDOW* pWindow, MSG* pMsg)
+{
+	switch (pMsg->message)
+	{
+		case MESSAGE_KEYDOWN:
+		{
+			switch (pMsg->param1)
+			{
+				case KEY_ESCAPE:
+					window_end_modal(0);
+					return 0;
+
+				case KEY_ENTER:
+                    invoke_command((LISTBOX*)pWindow);
+					return 0;
+			}
+			break;
+		}
+	}
+
+	return listbox_wndproc(pWindow, pMsg);
+}
+
+// Choose which program on a multi-program tape to start playing from
+void tape_menu()
+{
+	if (g_casIndexCount == 0)
+	{
+		message_box("Choose Program", "No programs found", okButtons, MB_ERROR);
+		return;
+	}
+
+	uint8_t selected = 0;
+	for (uint8_t i=0; i<g_casIndexCount; i++)
+	{
+		sprintf(item_text[i], "%-7s %s", g_casIndex[i].type == 'S' ? "SYSTEM" : "BASIC", g_casIndex[i].name);
+		items[i] = item_text[i];
+		if (g_casIndex[i].offset == g_casStartPos)
+			selected = i;
+	}
+	items[g_casIndexCount] = NULL;
+
+	LISTBOX lb;
+	memset(&lb, 0, sizeof(LISTBOX));
+
+	lb.window.rcFrame.left = 2;
+	lb.window.rcFrame.top = 1;
+	lb.window.rcFrame.width = 20;
+	lb.window.rcFrame.height = g_casIndexCount + 2;
+	lb.window.attrNormal = MAKECOLOR(COLOR_WHITE, COLOR_BLUE);
+	lb.window.attrSelected = MAKECOLOR(COLOR_BLACK, COLOR_YELLOW);
+	lb.window.title = "Choose Program";
+	lb.window.wndProc = tape_menu_proc;
+	lb.selectedItem = selected;
+    listbox_set_data(&lb, -1, items);
+
+	window_run_modal(&lb.window);
+}
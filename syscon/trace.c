@@ -0,0 +1,106 @@
+#include "syscon.h"
+
+// Binary trace log
+//
+// Events are stored in a ring buffer as an event id, an argument count
+// and the raw 16-bit arguments.  Nothing is formatted on the Z80 - the
+// "log" serial command sends the buffered records and `bet log` formats
+// them on the host (see tools/bet/trace-events.js).
+//
+// If the buffer fills, new events are dropped and counted.  The count is
+// reported as a TRACE_DROPPED event the next time the log is drained.
+
+#define TRACE_BUFFER_SIZE	512
+#define TRACE_MAX_ARGS		4
+
+static uint8_t g_traceBuf[TRACE_BUFFER_SIZE];
+static uint16_t g_traceHead = 0;		// Write position
+static uint16_t g_traceTail = 0;		// Read position
+static uint16_t g_traceDropped = 0;
+
+// Append a record to the ring buffer
+static void trace_write(uint8_t id, uint8_t argc, const uint16_t* args)
+{
+	uint8_t length = 2 + argc * 2;
+	uint16_t used = (g_traceHead - g_traceTail) & (TRACE_BUFFER_SIZE - 1);
+	if (used + length >= TRACE_BUFFER_SIZE)
+	{
+		g_traceDropped++;
+		return;
+	}
+
+	const uint8_t* p = (const uint8_t*)args;
+	g_traceBuf[g_traceHead] = id;
+	g_traceHead = (g_traceHead + 1) & (TRACE_BUFFER_SIZE - 1);
+	g_traceBuf[g_traceHead] = argc;
+	g_traceHead = (g_traceHead + 1) & (TRACE_BUFFER_SIZE - 1);
+	for (uint8_t i=2; i<length; i++)
+	{
+		g_traceBuf[g_traceHead] = *p++;
+		g_traceHead = (g_traceHead + 1) & (TRACE_BUFFER_SIZE - 1);
+	}
+}
+
+void trace_0(uint8_t id)
+{
+	trace_write(id, 0, NULL);
+}
+
+void trace_1(uint8_t id, uint16_t a)
+{
+	trace_write(id, 1, &a);
+}
+
+void trace_2(uint8_t id, uint16_t a, uint16_t b)
+{
+	uint16_t args[2];
+	args[0] = a;
+	args[1] = b;
+	trace_write(id, 2, args);
+}
+
+// Two 32-bit arguments (sent as four 16-bit words, low word first)
+void trace_2l(uint8_t id, uint32_t a, uint32_t b)
+{
+	uint32_t args[2];
+	args[0] = a;
+	args[1] = b;
+	trace_write(id, 4, (const uint16_t*)args);
+}
+
+// Send all buffered records over the uart, each prefixed with
+// TRACE_MARKER and terminated by a TRACE_END record.
+void trace_drain()
+{
+	uint8_t rec[2 + TRACE_MAX_ARGS * 2 + 1];
+
+	rec[0] = TRACE_MARKER;
+	if (g_traceDropped)
+	{
+		rec[1] = TRACE_DROPPED;
+		rec[2] = 1;
+		rec[3] = g_traceDropped & 0xFF;
+		rec[4] = g_traceDropped >> 8;
+		uart_write(rec, 5);
+		g_traceDropped = 0;
+	}
+
+	while (g_traceTail != g_traceHead)
+	{
+		rec[1] = g_traceBuf[g_traceTail];
+		g_traceTail = (g_traceTail + 1) & (TRACE_BUFFER_SIZE - 1);
+		uint8_t argc = g_traceBuf[g_traceTail];
+		g_traceTail = (g_traceTail + 1) & (TRACE_BUFFER_SIZE - 1);
+		rec[2] = argc;
+		for (uint8_t i=0; i<argc * 2; i++)
+		{
+			rec[3 + i] = g_traceBuf[g_traceTail];
+			g_traceTail = (g_traceTail + 1) & (TRACE_BUFFER_SIZE - 1);
+		}
+		uart_write(rec, 3 + argc * 2);
+	}
+
+	rec[1] = TRACE_END;
+	rec[2] = 0;
+	uart_write(rec, 3);
+}
@@ -5,7 +5,19 @@ char g_szLineBuf[128];
 uint8_t g_iLineBufPos = 0;
 
 void cmd_push(uint8_t argc, const char** argv);
+void cmd_spush(uint8_t argc, const char** argv);
+void cmd_uart(uint8_t argc, const char** argv);
 void cmd_reset(uint8_t argc, const char** argv);
+void cmd_list(uint8_t argc, const char** argv);
+void cmd_crc(uint8_t argc, const char** argv);
+void cmd_cache(uint8_t argc, const char** argv);
+void cmd_log(uint8_t argc, const char** argv);
+void cmd_type(uint8_t argc, const char** argv);
+void cmd_peek(uint8_t argc, const char** argv);
+void cmd_poke(uint8_t argc, const char** argv);
+void cmd_perf(uint8_t argc, const char** argv);
+void cmd_boot(uint8_t argc, const char** argv);
+void cmd_screen(uint8_t argc, const char** argv);
 
 
 typedef struct _CMD
@@ -16,7 +28,19 @@ typedef struct _CMD
 
 CMD g_commands[] = {
     { "push", cmd_push },
+    { "spush", cmd_spush },
+    { "uart", cmd_uart },
     { "reset", cmd_reset },
+    { "list", cmd_list },
+    { "crc", cmd_crc },
+    { "cache", cmd_cache },
+    { "log", cmd_log },
+    { "type", cmd_type },
+    { "peek", cmd_peek },
+    { "poke", cmd_poke },
+    { "perf", cmd_perf },
+    { "boot", cmd_boot },
+    { "screen", cmd_screen },
     { NULL, NULL },
 };
 
@@ -87,7 +111,7 @@ void uart_fiber_proc()
 
     while (true)
     {
-        uint8_t len = uart_read(g_szUartBuf, sizeof(g_szUartBuf));
+        uint8_t len = uart_fifo_read(g_szUartBuf, sizeof(g_szUartBuf));
         char* p = g_szUartBuf;
         bool bWasCR = false;
         while (len)
@@ -135,20 +159,39 @@ void uart_init()
     // Initialize interrupt service routines
     uart_read_init_isr();
     uart_write_init_isr();
+    uart_fifo_init();
 
     // Start fiber
     create_fiber(uart_fiber_proc, 1024);
 }
 
 
-uint8_t calculateChecksum(uint8_t* p, uint8_t length)
+// 8-bit sum of a block (26 T-states per byte)
+uint8_t calculateChecksum(uint8_t* p, uint8_t length) __naked
 {
-    uint8_t checksum = 0;
-    for (uint8_t i=0; i<length; i++)
-    {
-        checksum += *p++;
-    }
-    return checksum;
+	p; length;
+__asm
+		ld	hl, #2
+		add hl,sp
+		ld	e,(hl)
+		inc	hl
+		ld	d,(hl)
+		inc	hl
+		ld	b,(hl)
+		ex	de,hl
+
+		xor	a
+		inc	b
+		jr	20$
+10$:
+		add	a,(hl)
+		inc	hl
+20$:
+		djnz	10$
+
+		ld	l,a
+		ret
+__endasm;
 }
 
 
@@ -179,14 +222,14 @@ void cmd_push(uint8_t argc, const char** argv)
 
         // Read block length
         uint8_t blockSize;
-        uart_read_wait(&blockSize, 1);
+        uart_fifo_read_wait(&blockSize, 1);
 
         // Read the data
-        uart_read_wait(buf, blockSize);
+        uart_fifo_read_wait(buf, blockSize);
 
         // Read the checksum
         uint8_t checksumSent;
-        uart_read_wait(&checksumSent, 1);
+        uart_fifo_read_wait(&checksumSent, 1);
 
         // Check it
         uint8_t checksumData = calculateChecksum(buf, blockSize);
@@ -227,7 +270,7 @@ void cmd_push(uint8_t argc, const char** argv)
 
     // Read the eot
     char chEot;
-    uart_read_wait(&chEot, 1);
+    uart_fifo_read_wait(&chEot, 1);
 
     if (chEot != CHAR_EOT)
     {
@@ -249,7 +292,608 @@ void cmd_push(uint8_t argc, const char** argv)
     uart_write_char(CHAR_ACK);
 }
 
+// Parse a hex string
+uint32_t parse_hex(const char* p)
+{
+    uint32_t val = 0;
+    while (true)
+    {
+        char ch = *p++;
+        if (ch >= '0' && ch <= '9')
+            val = (val << 4) | (ch - '0');
+        else if (ch >= 'a' && ch <= 'f')
+            val = (val << 4) | (ch - 'a' + 10);
+        else if (ch >= 'A' && ch <= 'F')
+            val = (val << 4) | (ch - 'A' + 10);
+        else
+            return val;
+    }
+}
+
+// Streamed push.  Unlike cmd_push there's no per-block handshake - the 
+// client streams the whole file and we ack every 512 bytes so it can 
+// keep a bounded window in flight.  Integrity is checked with a crc32 
+// of the entire file.  If writing fails the rest of the stream is still
+// received (and discarded) so it isn't interpreted as commands.
+//
+//   spush <filename> <size> <crc32 hex>
+void cmd_spush(uint8_t argc, const char** argv)
+{
+    if (argc < 4)
+    {
+        uart_write_sz("!missing args\n");
+        return;
+    }
+
+    // Capture filename, size and crc
+    const char* pszFileName = argv[1];
+    uint32_t size = atol(argv[2]);
+    uint32_t crcSent = parse_hex(argv[3]);
+
+    char buf[128];
+
+    // Create a temp file
+    FIL f;
+    FRESULT err = f_open(&f, "0:/receive.tmp", FA_WRITE | FA_CREATE_ALWAYS);
+    if (err)
+    {
+        uart_write_sz("!f_open\n");
+        return;
+    }
+
+    // Ready to receive
+    uart_write_char(CHAR_ACK);
+
+    // Receive data
+    uint32_t received = 0;
+    uint32_t crc = 0;
+    bool bWriteFailed = false;
+    while (received < size)
+    {
+        uint8_t blockSize = size - received > sizeof(buf) ? sizeof(buf) : (uint8_t)(size - received);
+        uart_fifo_read_wait(buf, blockSize);
+
+        crc = crc32_update(crc, buf, blockSize);
+
+        if (!bWriteFailed)
+        {
+            UINT unused;
+            if (f_write(&f, buf, blockSize, &unused))
+                bWriteFailed = true;
+        }
+
+        received += blockSize;
+
+        // Ack each 512 bytes to open the client's window
+        if ((received & 511) == 0)
+        {
+            trace_2l(TRACE_SPUSH, received, size);
+            uart_write_char(CHAR_ACK);
+        }
+    }
+
+    // Close the file
+    f_close(&f);
+
+    if (bWriteFailed)
+    {
+        uart_write_sz("!f_write\n");
+        f_unlink("0:/receive.tmp");
+        return;
+    }
+
+    // Check crc
+    if (crc != crcSent)
+    {
+        sprintf(g_szTemp, "!crc:%08lx!=%08lx\n", (unsigned long)crcSent, (unsigned long)crc);
+        uart_write_sz(g_szTemp);
+        f_unlink("0:/receive.tmp");
+        return;
+    }
+
+    // Replace file
+    f_unlink(pszFileName);
+    err = f_rename("0:\\receive.tmp", pszFileName);
+    if (err)
+    {
+        sprintf(g_szTemp, "!f_rename(\"%s\")=%i\n", pszFileName, err);
+        uart_write_sz(g_szTemp);
+        return;
+    }
+
+    // Done
+    uart_write_char(CHAR_ACK);
+}
+
+// Display receive fifo status and error counters
+void cmd_uart(uint8_t argc, const char** argv)
+{
+    sprintf(g_szTemp, "status:%02x overruns:%u framing:%u\n", 
+        (int)UartFifoStatusPort,
+        (int)UartFifoOverrunPort,
+        (int)UartFifoErrorPort
+        );
+    uart_write_sz(g_szTemp);
+
+    if (argc > 1 && strcmp(argv[1], "clear") == 0)
+        UartFifoStatusPort = UART_FIFO_CONTROL_ENABLE | UART_FIFO_CONTROL_CLEAR_ERRORS;
+}
+
 void cmd_reset(uint8_t argc, const char** argv)
 {
+    disk_cache_sync();
     ApmEnable = APM_ENABLE_RESET;
 }
+
+// List files in a directory.  Each file is listed as "<size> <name>" and
+// the list is terminated by a blank line.  Sub-directories aren't listed.
+void cmd_list(uint8_t argc, const char** argv)
+{
+    DIR dir;
+    FILINFO fi;
+    FRESULT err = f_opendir(&dir, argc > 1 ? argv[1] : "/");
+    if (err)
+    {
+        sprintf(g_szTemp, "!f_opendir=%i\n", err);
+        uart_write_sz(g_szTemp);
+        return;
+    }
+
+    while (true)
+    {
+        err = f_readdir(&dir, &fi);
+        if (err || fi.fname[0] == '\0')
+            break;
+
+        if (fi.fattrib & (AM_DIR | AM_HID | AM_SYS))
+            continue;
+
+        sprintf(g_szTemp, "%lu %s\n", (unsigned long)fi.fsize, fi.fname);
+        uart_write_sz(g_szTemp);
+    }
+
+    f_closedir(&dir);
+
+    uart_write_char('\n');
+}
+
+// Calculate the crc32 of a file and reply with "<size> <crc>"
+void cmd_crc(uint8_t argc, const char** argv)
+{
+    if (argc < 2)
+    {
+        uart_write_sz("!missing filename\n");
+        return;
+    }
+
+    uint32_t crc;
+    uint32_t size;
+    FRESULT err = crc32_file(argv[1], &crc, &size);
+    if (err)
+    {
+        sprintf(g_szTemp, "!crc32_file=%i\n", err);
+        uart_write_sz(g_szTemp);
+        return;
+    }
+
+    sprintf(g_szTemp, "%lu %08lx\n", (unsigned long)size, (unsigned long)crc);
+    uart_write_sz(g_szTemp);
+}
+
+// Display SD sector cache counters
+void cmd_cache(uint8_t argc, const char** argv)
+{
+    sprintf(g_szTemp, "hits:%lu misses:%lu writebacks:%lu\n",
+        (unsigned long)g_diskCacheHits,
+        (unsigned long)g_diskCacheMisses,
+        (unsigned long)g_diskCacheWriteBacks
+        );
+    uart_write_sz(g_szTemp);
+
+    if (argc > 1 && strcmp(argv[1], "clear") == 0)
+    {
+        g_diskCacheHits = 0;
+        g_diskCacheMisses = 0;
+        g_diskCacheWriteBacks = 0;
+    }
+}
+
+// Send the binary trace log (decoded by `bet log`)
+void cmd_log(uint8_t argc, const char** argv)
+{
+    trace_drain();
+}
+
+// Type text on the TRS-80 keyboard.  After the initial ack the client
+// streams the text and we ack every 64 characters typed so the client
+// can keep a bounded window in flight.
+//
+//   type <length>
+void cmd_type(uint8_t argc, const char** argv)
+{
+    if (argc < 2)
+    {
+        uart_write_sz("!missing args\n");
+        return;
+    }
+
+    uint32_t length = atol(argv[1]);
+    char buf[64];
+
+    // Ready to receive
+    uart_write_char(CHAR_ACK);
+
+    uint32_t typed = 0;
+    while (typed < length)
+    {
+        uint8_t chunk = length - typed > sizeof(buf) ? sizeof(buf) : (uint8_t)(length - typed);
+        chunk = uart_fifo_read(buf, chunk);
+
+        for (uint8_t i=0; i<chunk; i++)
+            key_type_char(buf[i]);
+
+        // Ack each 64 characters
+        if (((typed + chunk) & ~63) != (typed & ~63))
+            uart_write_char(CHAR_ACK);
+        typed += chunk;
+    }
+
+    // Done
+    uart_write_char(CHAR_ACK);
+}
+
+// Read TRS-80 memory.  Replies with the bytes as a single line of hex.
+//
+//   peek <address hex> <length>
+void cmd_peek(uint8_t argc, const char** argv)
+{
+    if (argc < 3)
+    {
+        uart_write_sz("!missing args\n");
+        return;
+    }
+
+    uint16_t addr = parse_hex(argv[1]);
+    uint8_t length = atoi(argv[2]);
+    uint8_t buf[32];
+    if (length > sizeof(buf))
+    {
+        uart_write_sz("!too long\n");
+        return;
+    }
+
+    // TRS-80 address space maps directly onto the first 64 banks
+    bank_read(0, addr, buf, length);
+
+    char* p = g_szTemp;
+    for (uint8_t i=0; i<length; i++)
+    {
+        sprintf(p, "%02x", (int)buf[i]);
+        p += 2;
+    }
+    *p++ = '\n';
+    *p = '\0';
+    uart_write_sz(g_szTemp);
+}
+
+// Write a block of data directly into TRS-80 RAM.  Streamed the same way
+// as spush - acked every 512 bytes and checked with a crc32 of the whole
+// block.  Used by `bet run` to load tokenized BASIC programs.
+//
+// The data is written to TRS-80 RAM as it arrives so a crc failure only
+// reports the error - memory has already been overwritten.
+//
+//   poke <address hex> <length> <crc32 hex>
+void cmd_poke(uint8_t argc, const char** argv)
+{
+    if (argc < 4)
+    {
+        uart_write_sz("!missing args\n");
+        return;
+    }
+
+    uint16_t addr = parse_hex(argv[1]);
+    uint32_t size = atol(argv[2]);
+    uint32_t crcSent = parse_hex(argv[3]);
+
+    // Only allow writes to RAM (0x4000 and above)
+    if (addr < 0x4000 || addr + size > 0x10000)
+    {
+        uart_write_sz("!bad address\n");
+        return;
+    }
+
+    char buf[128];
+
+    // Ready to receive
+    uart_write_char(CHAR_ACK);
+
+    uint32_t received = 0;
+    uint32_t crc = 0;
+    while (received < size)
+    {
+        uint8_t blockSize = size - received > sizeof(buf) ? sizeof(buf) : (uint8_t)(size - received);
+        uart_fifo_read_wait(buf, blockSize);
+
+        crc = crc32_update(crc, buf, blockSize);
+        bank_write(0, addr, buf, blockSize);
+
+        addr += blockSize;
+        received += blockSize;
+
+        // Ack each 512 bytes to open the client's window
+        if ((received & 511) == 0)
+            uart_write_char(CHAR_ACK);
+    }
+
+    // Check crc
+    if (crc != crcSent)
+    {
+        sprintf(g_szTemp, "!crc:%08lx!=%08lx\n", (unsigned long)crcSent, (unsigned long)crc);
+        uart_write_sz(g_szTemp);
+        return;
+    }
+
+    // Done
+    uart_write_char(CHAR_ACK);
+}
+
+// Send a snapshot of the hardware performance counters as a single line
+// of 32-bit hex values (see PERF_xxx in syscon.h).  The counters are free
+// running so `bet perf` polls and displays the differences.
+void cmd_perf(uint8_t argc, const char** argv)
+{
+    PerfLatchPort = 0;
+
+    char* p = g_szTemp;
+    for (uint8_t i=0; i<PERF_COUNTER_COUNT; i++)
+    {
+        PerfSelectPort = i;
+        uint32_t val = PerfData0Port | 
+                ((uint32_t)PerfData1Port << 8) | 
+                ((uint32_t)PerfData2Port << 16) | 
+                ((uint32_t)PerfData3Port << 24);
+        sprintf(p, i ? " %08lx" : "%08lx", (unsigned long)val);
+        p += strlen(p);
+    }
+    *p++ = '\n';
+    *p = '\0';
+    uart_write_sz(g_szTemp);
+}
+
+// big80.sys is linked with data at 0xC000 (see makefile) so the image
+// itself must fit below that
+#define BOOT_MAX_SIZE		0xC000
+
+// Restarting copies the image with a thunk in high memory, above the
+// image and outside the page bank window
+#define BOOT_THUNK_ADDR		0xFB00
+
+// Copy a staged image over the running firmware and jump to it, the same
+// way the bootrom starts big80.sys.  Never returns.
+void hot_boot(uint8_t firstBank, uint8_t bankCount) __naked
+{
+	firstBank; bankCount;
+__asm
+		; Work out the end bank
+		ld	hl, #2
+		add hl,sp
+		ld	e,(hl)
+		inc	hl
+		ld	a,(hl)
+		add	a,e
+		ld	d,a
+		push de
+
+		; Copy the thunk to high memory
+		ld	hl,#90$
+		ld	de,#BOOT_THUNK_ADDR
+		ld	bc,#99$ - 90$
+		ldir
+
+		; Patch the end bank into it
+		pop	de
+		ld	a,d
+		ld	(#BOOT_THUNK_ADDR + 91$ - 90$ + 1),a
+
+		; Map the page bank and jump to it with A = first bank
+		ld	a,#APM_ENABLE_PAGEBANK
+		out	(_ApmEnable),a
+		ld	a,e
+		jp	BOOT_THUNK_ADDR
+
+90$:
+		; Copy each bank to the syscon address space starting at 0
+		ld	de,#0x0000
+80$:
+		out	(_ApmPageBank),a
+		ld	hl,#0xFC00
+		ld	bc,#0x0400
+		ldir
+		inc	a
+91$:
+		cp	#0
+		jr	nz,80$
+
+		; Unmap and jump to the new big80.sys entry point
+		xor	a
+		out	(_ApmEnable),a
+		jp	0x0000
+99$:
+__endasm;
+}
+
+// Receive a new big80.sys and restart it without rebooting through the
+// bootrom or touching the SD card.  Streamed the same way as spush.  The
+// image is staged in spare banks until the crc has been checked, then
+// copied over the running firmware.  The TRS-80's memory is left alone
+// so the restarted syscon finds the ROM image still resident.
+//
+// There's no final ack - the client waits for the new firmware's
+// start up message instead.  (The bootrom's load stamp for big80.sys no
+// longer matches, so the next reset reloads it from the SD card)
+//
+//   boot <size> <crc32 hex>
+void cmd_boot(uint8_t argc, const char** argv)
+{
+    if (argc < 3)
+    {
+        uart_write_sz("!missing args\n");
+        return;
+    }
+
+    uint32_t size = atol(argv[1]);
+    uint32_t crcSent = parse_hex(argv[2]);
+
+    if (size == 0 || size > BOOT_MAX_SIZE)
+    {
+        uart_write_sz("!bad size\n");
+        return;
+    }
+
+    // Allocate staging banks
+    uint8_t bankCount = (uint8_t)((size + 1023) / 1024);
+    uint8_t firstBank = bank_alloc(bankCount);
+    if (!firstBank)
+    {
+        uart_write_sz("!out of banks\n");
+        return;
+    }
+
+    char buf[128];
+
+    // Ready to receive
+    uart_write_char(CHAR_ACK);
+
+    uint32_t received = 0;
+    uint32_t crc = 0;
+    while (received < size)
+    {
+        uint8_t blockSize = size - received > sizeof(buf) ? sizeof(buf) : (uint8_t)(size - received);
+        uart_fifo_read_wait(buf, blockSize);
+
+        crc = crc32_update(crc, buf, blockSize);
+        bank_write(firstBank, (uint16_t)received, buf, blockSize);
+
+        received += blockSize;
+
+        // Ack each 512 bytes to open the client's window
+        if ((received & 511) == 0)
+            uart_write_char(CHAR_ACK);
+    }
+
+    // Check crc
+    if (crc != crcSent)
+    {
+        bank_free(firstBank, bankCount);
+        sprintf(g_szTemp, "!crc:%08lx!=%08lx\n", (unsigned long)crcSent, (unsigned long)crc);
+        uart_write_sz(g_szTemp);
+        return;
+    }
+
+    // Flush anything the running firmware has cached and restart
+    disk_cache_sync();
+    hot_boot(firstBank, bankCount);
+}
+
+// Syscon overlay characters (32x16) when the video bank is mapped
+__at(0xFC00) uint8_t overlay_chars[];
+
+// Overlay as last sent, the overlay has no dirty flags in hardware
+uint8_t g_screenOverlayShadow[32 * 16];
+
+// Run length encode a row for cmd_screen.  Each run starts with a count
+// byte - below 0x80 it's followed by count+1 literal bytes, otherwise by
+// a single byte repeated count-0x80+3 times.  Returns the encoded length
+// which is at most length + length/128 + 1.
+uint8_t screen_rle(const uint8_t* src, uint8_t length, uint8_t* dst)
+{
+    uint8_t* p = dst;
+    uint8_t i = 0;
+    while (i < length)
+    {
+        // Repeat?
+        uint8_t run = 1;
+        while (i + run < length && src[i + run] == src[i] && run < 130)
+            run++;
+        if (run >= 3)
+        {
+            *p++ = 0x80 + run - 3;
+            *p++ = src[i];
+            i += run;
+            continue;
+        }
+
+        // Literals up to the next repeat
+        uint8_t j = i;
+        while (j < length && j - i < 128)
+        {
+            if (j + 2 < length && src[j] == src[j + 1] && src[j] == src[j + 2])
+                break;
+            j++;
+        }
+        *p++ = j - i - 1;
+        memcpy(p, src + i, j - i);
+        p += j - i;
+        i = j;
+    }
+    return p - dst;
+}
+
+// Send a row record - row id, encoded length and the encoded row
+void screen_send_row(uint8_t row, const uint8_t* data, uint8_t length)
+{
+    uint8_t buf[2 + 64 + 2];
+    cassette_poll();
+    buf[0] = row;
+    buf[1] = screen_rle(data, length, buf + 2);
+    uart_write(buf, 2 + buf[1]);
+}
+
+// Send the rows of the TRS-80 screen and syscon overlay that have changed
+// since the last call (decoded by `bet screen`).  The reply is SCREEN_MARKER,
+// a flags byte (SCREEN_FLAG_xxx), the changed rows (see screen_send_row)
+// and SCREEN_END.  The client polls so the rate adapts to the baud rate.
+//
+//   screen [full]
+void cmd_screen(uint8_t argc, const char** argv)
+{
+    bool full = argc > 1 && strcmp(argv[1], "full") == 0;
+    uint8_t buf[64];
+
+    buf[0] = SCREEN_MARKER;
+    buf[1] = (ApmEnable & APM_ENABLE_VIDEOSHOW) ? SCREEN_FLAG_OVERLAY : 0;
+    uart_write(buf, 2);
+
+    // TRS-80 rows, selecting a row clears its dirty flag
+    uint16_t dirty = ScreenDirtyLoPort | (ScreenDirtyHiPort << 8);
+    for (uint8_t row=0; row<16; row++)
+    {
+        if (!full && !(dirty & (1 << row)))
+            continue;
+
+        ScreenRowPort = row;
+        for (uint8_t i=0; i<64; i++)
+            buf[i] = ScreenDataPort;
+        screen_send_row(row, buf, 64);
+    }
+
+    // Overlay rows, compared against what was last sent
+    for (uint8_t row=0; row<16; row++)
+    {
+        uint8_t save = ApmEnable;
+        ApmEnable = (save & ~APM_ENABLE_PAGEBANK) | APM_ENABLE_VIDEOBANK;
+        memcpy(buf, overlay_chars + row * 32, 32);
+        ApmEnable = save;
+
+        uint8_t* pShadow = g_screenOverlayShadow + row * 32;
+        if (!full && memcmp(buf, pShadow, 32) == 0)
+            continue;
+
+        memcpy(pShadow, buf, 32);
+        screen_send_row(SCREEN_ROW_OVERLAY + row, buf, 32);
+    }
+
+    buf[0] = SCREEN_END;
+    uart_write(buf, 1);
+}
@@ -0,0 +1,56 @@
+#include "syscon.h"
+
+// Receives serial data via the hardware receive fifo (SysConSerialRxFifo)
+// instead of libSysCon's interrupt driven receive buffer.  The fifo is
+// deep enough to absorb incoming data while fibers are stalled on SD
+// card operations.
+
+SIGNAL g_sig_uart_fifo;
+
+// Read up to length bytes, waiting for at least one
+uint8_t uart_fifo_read(void* p, uint8_t length)
+{
+    uint8_t* pb = (uint8_t*)p;
+    uint8_t count = 0;
+
+    while (true)
+    {
+        while (count < length && (UartFifoStatusPort & UART_FIFO_STATUS_AVAILABLE))
+        {
+            *pb++ = UartFifoDataPort;
+            count++;
+        }
+
+        if (count)
+            return count;
+
+        wait_signal(&g_sig_uart_fifo);
+    }
+}
+
+// Read exactly length bytes
+void uart_fifo_read_wait(void* p, uint16_t length)
+{
+    uint8_t* pb = (uint8_t*)p;
+    while (length)
+    {
+        uint8_t count = uart_fifo_read(pb, length > 255 ? 255 : (uint8_t)length);
+        pb += count;
+        length -= count;
+    }
+}
+
+void uart_fifo_init()
+{
+    init_signal(&g_sig_uart_fifo);
+
+    // Enable the fifo and reset error counters.  Once enabled the hardware
+    // masks the serial port's own rx interrupt.
+    UartFifoStatusPort = UART_FIFO_CONTROL_ENABLE | UART_FIFO_CONTROL_CLEAR_ERRORS;
+}
+
+void uart_fifo_isr()
+{
+    if (InterruptControllerPort & IRQ_UART_FIFO)
+        set_signal(&g_sig_uart_fifo);
+}
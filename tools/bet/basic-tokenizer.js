@@ -0,0 +1,231 @@
+// Level II BASIC tokenizer
+//
+// Converts a BASIC listing into the in-memory format the Level II ROM
+// uses for a program.  The crunching rules follow the ROM's own routine
+// at 1BC0h (see resources/Trs80Level2Rom/level2-a.lst) so the result is
+// identical to typing the listing in:
+//
+//  * keywords are matched in table order, first match wins
+//  * strings, DATA (up to the next ':') and REM are stored as is
+//  * digits and ':' ';' are never the start of a keyword
+//  * '?' is PRINT, ELSE is stored as ":ELSE" and ' as ":REM'"
+//  * GOTO may be written with spaces (eg: "GO TO")
+//  * everything else is upper cased
+
+// Reserved word table at 1650h.  Token values start at 80h.
+const keywords = [
+    "END", "FOR", "RESET", "SET", "CLS", "CMD", "RANDOM", "NEXT",
+    "DATA", "INPUT", "DIM", "READ", "LET", "GOTO", "RUN", "IF",
+    "RESTORE", "GOSUB", "RETURN", "REM", "STOP", "ELSE", "TRON", "TROFF",
+    "DEFSTR", "DEFINT", "DEFSNG", "DEFDBL", "LINE", "EDIT", "ERROR", "RESUME",
+    "OUT", "ON", "OPEN", "FIELD", "GET", "PUT", "CLOSE", "LOAD",
+    "MERGE", "NAME", "KILL", "LSET", "RSET", "SAVE", "SYSTEM", "LPRINT",
+    "DEF", "POKE", "PRINT", "CONT", "LIST", "LLIST", "DELETE", "AUTO",
+    "CLEAR", "CLOAD", "CSAVE", "NEW", "TAB(", "TO", "FN", "USING",
+    "VARPTR", "USR", "ERL", "ERR", "STRING$", "INSTR", "POINT", "TIME$",
+    "MEM", "INKEY$", "THEN", "NOT", "STEP", "+", "-", "*",
+    "/", "[", "AND", "OR", ">", "=", "<", "SGN",
+    "INT", "ABS", "FRE", "INP", "POS", "SQR", "RND", "LOG",
+    "EXP", "COS", "SIN", "TAN", "ATN", "PEEK", "CVI", "CVS",
+    "CVD", "EOF", "LOC", "LOF", "MKI$", "MKS$", "MKD$", "CINT",
+    "CSNG", "CDBL", "FIX", "LEN", "STR$", "VAL", "ASC", "CHR$",
+    "LEFT$", "RIGHT$", "MID$", "'",
+];
+
+const TOKEN_DATA = 0x88;
+const TOKEN_GOTO = 0x8D;
+const TOKEN_REM = 0x93;
+const TOKEN_ELSE = 0x95;
+const TOKEN_PRINT = 0xB2;
+const TOKEN_QUOTE = 0xFB;
+
+function upper(ch)
+{
+    return ch >= 0x61 && ch <= 0x7A ? ch & 0x5F : ch;
+}
+
+// Match a keyword at position pos, returns { token, length } or null
+function matchKeyword(text, pos)
+{
+    for (let i=0; i<keywords.length; i++)
+    {
+        let kw = keywords[i];
+        let token = 0x80 + i;
+        let p = pos;
+        let j;
+        for (j=0; j<kw.length; j++)
+        {
+            // The ROM skips spaces between the letters of GOTO
+            if (token == TOKEN_GOTO && j > 0)
+            {
+                while (p < text.length && text[p] == 0x20)
+                    p++;
+            }
+
+            if (p >= text.length || upper(text[p]) != kw.charCodeAt(j))
+                break;
+            p++;
+        }
+
+        if (j == kw.length)
+            return { token: token, length: p - pos };
+    }
+    return null;
+}
+
+// Crunch the text of one line (without its line number)
+function crunchLine(text)
+{
+    let out = [];
+    let inData = false;
+    let pos = 0;
+
+    // Copy everything up to the closing quote (or end of line)
+    function copyString()
+    {
+        out.push(text[pos++]);
+        while (pos < text.length)
+        {
+            let ch = text[pos++];
+            out.push(ch);
+            if (ch == 0x22)
+                break;
+        }
+    }
+
+    // Copy the rest of the line
+    function copyRest()
+    {
+        while (pos < text.length)
+            out.push(text[pos++]);
+    }
+
+    while (pos < text.length)
+    {
+        let ch = text[pos];
+
+        if (ch == 0x22)
+        {
+            copyString();
+            continue;
+        }
+
+        if (ch == 0x20 || inData)
+        {
+            out.push(ch);
+            pos++;
+            if (ch == 0x3A)
+                inData = false;
+            continue;
+        }
+
+        if (ch == 0x3F)
+        {
+            out.push(TOKEN_PRINT);
+            pos++;
+            continue;
+        }
+
+        let m = null;
+        if (ch < 0x30 || ch >= 0x3C)
+            m = matchKeyword(text, pos);
+
+        if (!m)
+        {
+            out.push(upper(ch));
+            pos++;
+            continue;
+        }
+
+        pos += m.length;
+
+        switch (m.token)
+        {
+            case TOKEN_ELSE:
+                out.push(0x3A, TOKEN_ELSE);
+                break;
+
+            case TOKEN_QUOTE:
+                out.push(0x3A, TOKEN_REM, TOKEN_QUOTE);
+                copyRest();
+                break;
+
+            case TOKEN_REM:
+                out.push(TOKEN_REM);
+                copyRest();
+                break;
+
+            case TOKEN_DATA:
+                out.push(TOKEN_DATA);
+                inData = true;
+                break;
+
+            default:
+                out.push(m.token);
+                break;
+        }
+    }
+
+    return out;
+}
+
+// Tokenize a listing to be loaded at address base.  Returns a buffer
+// containing the program (including the terminating null link).
+function tokenize(source, base)
+{
+    let lines = [];
+
+    let sourceLines = source.replace(/\r\n?/g, "\n").split("\n");
+    for (let i=0; i<sourceLines.length; i++)
+    {
+        let text = Buffer.from(sourceLines[i], "latin1");
+
+        // Skip blank lines
+        let pos = 0;
+        while (pos < text.length && (text[pos] == 0x20 || text[pos] == 0x09))
+            pos++;
+        if (pos == text.length)
+            continue;
+
+        // Parse line number
+        let lineNumber = 0;
+        let digits = 0;
+        while (pos < text.length && text[pos] >= 0x30 && text[pos] <= 0x39)
+        {
+            lineNumber = lineNumber * 10 + text[pos++] - 0x30;
+            digits++;
+        }
+        if (digits == 0 || lineNumber > 65529)
+            throw new Error(`Line ${i+1}: missing or invalid line number`);
+
+        // Skip spaces after the line number
+        while (pos < text.length && text[pos] == 0x20)
+            pos++;
+
+        if (lines.length > 0 && lineNumber <= lines[lines.length - 1].lineNumber)
+            throw new Error(`Line ${i+1}: line number ${lineNumber} out of order`);
+
+        lines.push({
+            lineNumber: lineNumber,
+            bytes: crunchLine(text.slice(pos)),
+        });
+    }
+
+    // Build the program, linking each line to the next
+    let out = [];
+    let addr = base;
+    for (let l of lines)
+    {
+        let next = addr + 4 + l.bytes.length + 1;
+        out.push(next & 0xFF, next >> 8);
+        out.push(l.lineNumber & 0xFF, l.lineNumber >> 8);
+        out.push(...l.bytes);
+        out.push(0);
+        addr = next;
+    }
+    out.push(0, 0);
+
+    return Buffer.from(out);
+}
+
+module.exports = tokenize;
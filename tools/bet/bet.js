@@ -10,7 +10,14 @@ function showHelp()
     console.log();
     console.log("Commands:");
     console.log("  push      push a file to FPGA SD card");
+    console.log("  sync      push new and changed files in a directory to FPGA SD card");
     console.log("  reset     soft reset the machine")
+    console.log("  log       display the syscon trace log")
+    console.log("  type      type a text file on the TRS-80 keyboard")
+    console.log("  run       load a BASIC listing straight into memory and run it")
+    console.log("  perf      display live hardware performance counters")
+    console.log("  boot      load and restart syscon firmware without writing it to SD card")
+    console.log("  screen    mirror the TRS-80 screen and syscon overlay in the terminal")
     console.log();
     console.log("For more help on a command, use bet <command> --help");
 }
@@ -27,10 +34,38 @@ switch (process.argv[2])
         require('./cmd-push')(process.argv.slice(2));
         break;
 
+    case "sync":
+        require('./cmd-sync')(process.argv.slice(2));
+        break;
+
     case "reset":
         require('./cmd-reset')(process.argv.slice(2));
         break;
 
+    case "log":
+        require('./cmd-log')(process.argv.slice(2));
+        break;
+
+    case "type":
+        require('./cmd-type')(process.argv.slice(2));
+        break;
+
+    case "run":
+        require('./cmd-run')(process.argv.slice(2));
+        break;
+
+    case "perf":
+        require('./cmd-perf')(process.argv.slice(2));
+        break;
+
+    case "boot":
+        require('./cmd-boot')(process.argv.slice(2));
+        break;
+
+    case "screen":
+        require('./cmd-screen')(process.argv.slice(2));
+        break;
+
     case "help":
         showHelp();
         break;
@@ -0,0 +1,124 @@
+let SerialConversation = require('./serial-conversation');
+let crc32 = require('./crc32');
+let fs = require('fs');
+
+function showHelp()
+{
+    console.log("Loads a new syscon firmware image over the serial port and restarts it");
+    console.log();
+    console.log("Usage: bet boot [options] big80.sys");
+    console.log();
+    console.log("The image isn't written to the SD card - the next reset reloads");
+    console.log("big80.sys from the card.  TRS-80 memory is left untouched.");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+}
+
+// Number of unacknowledged bytes allowed in flight.  The device acks
+// every 512 bytes.
+const streamWindow = 1024;
+
+// Message big80.sys sends on startup (see syscon/main.c)
+const landedMessage = "landed in big80.sys";
+
+
+// Handle for `boot` command
+async function cmd_boot(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+        }
+        let files = [];
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                files.push(arg);
+            }
+        }
+
+        if (files.length != 1)
+            throw new Error("Expected a single file name");
+
+        let image = fs.readFileSync(files[0]);
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        console.log(`Sending ${files[0]} (${image.length} bytes)`);
+
+        // Send command and wait for ack
+        await sc.write(`boot ${image.length} ${crc32(image).toString(16)}\n`);
+        await sc.waitAck();
+
+        // Stream the image
+        let pos = 0;
+        let acked = 0;
+        while (pos < image.length)
+        {
+            // Wait for window to open
+            while (pos - acked >= streamWindow)
+            {
+                await sc.waitAck();
+                acked += 512;
+            }
+
+            // Send the next chunk
+            let chunkLength = Math.min(image.length - pos, acked + streamWindow - pos, 256);
+            await sc.write(image.slice(pos, pos + chunkLength));
+            pos += chunkLength;
+        }
+
+        // The device restarts as soon as the crc checks out, so any
+        // remaining window acks may never arrive.  Wait for either an
+        // error or the new firmware's startup message.
+        while (true)
+        {
+            let line = (await sc.readToEOL()).replace(/\x06/g, "");
+            if (line.startsWith("!"))
+                throw new Error(`boot failed: ${line}`);
+            if (line.indexOf(landedMessage) >= 0)
+                break;
+        }
+
+        console.log("OK");
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_boot;
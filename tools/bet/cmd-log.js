@@ -0,0 +1,153 @@
+let SerialConversation = require('./serial-conversation');
+let traceEvents = require('./trace-events');
+
+function showHelp()
+{
+    console.log("Retrieves and displays the syscon trace log");
+    console.log();
+    console.log("Usage: bet log [options]");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+    console.log("  --follow           keep polling for new events (Ctrl+C to stop)")
+    console.log("  --interval:<ms>    polling interval when following (default 250)")
+}
+
+const TRACE_MARKER = 0x1E;
+const TRACE_END = 0;
+
+// Format one trace record
+function formatEvent(id, words)
+{
+    let def = traceEvents[id];
+    if (!def)
+        return `event_${id} ${words.map(x => x.toString(16)).join(" ")}`;
+
+    let parts = [ def.name ];
+    let w = 0;
+    for (let arg of def.args)
+    {
+        let spec = arg.split(":");
+        let value;
+        if (spec.indexOf("32") >= 0)
+        {
+            value = ((words[w + 1] << 16) | words[w]) >>> 0;
+            w += 2;
+        }
+        else
+        {
+            value = words[w];
+            w++;
+        }
+
+        if (spec.indexOf("x") >= 0)
+            parts.push(`${spec[0]}:0x${value.toString(16)}`);
+        else
+            parts.push(`${spec[0]}:${value}`);
+    }
+    return parts.join(" ");
+}
+
+// Read records until the end record, returns the number of events
+async function readLog(sc)
+{
+    let count = 0;
+    while (true)
+    {
+        // Skip anything that isn't a record (eg: text messages)
+        let marker = await sc.readWait(1);
+        if (marker[0] != TRACE_MARKER)
+            continue;
+
+        let header = await sc.readWait(2);
+        let words = [];
+        if (header[1] > 0)
+        {
+            let data = await sc.readWait(header[1] * 2);
+            for (let i=0; i<header[1]; i++)
+                words.push(data.readUInt16LE(i * 2));
+        }
+
+        if (header[0] == TRACE_END)
+            return count;
+
+        console.log(formatEvent(header[0], words));
+        count++;
+    }
+}
+
+
+// Handle for `log` command
+async function cmd_log(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+            follow: false,
+            interval: 250,
+        }
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+        
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "follow":
+                        options.follow = true;
+                        break;
+
+                    case "interval":
+                        options.interval = Number(parts[1]);
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+        
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                throw new Error(`Unexpected arg: ${arg}`)
+            }
+        }
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        do
+        {
+            await sc.write(`log\n`);
+            await readLog(sc);
+
+            if (options.follow)
+                await new Promise(resolve => setTimeout(resolve, options.interval));
+        } while (options.follow);
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_log;
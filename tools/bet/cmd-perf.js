@@ -0,0 +1,153 @@
+let SerialConversation = require('./serial-conversation');
+
+function showHelp()
+{
+    console.log("Displays live rates from the hardware performance counters");
+    console.log();
+    console.log("Usage: bet perf [options]");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+    console.log("  --interval:<ms>    sample interval (default 1000)")
+    console.log("  --once             show the raw counters once and exit")
+}
+
+// Counter indices (see syscon.h PERF_xxx)
+const PERF_CLOCK_CYCLES = 0;
+const PERF_CPU_CYCLES = 1;
+const PERF_RAM_WAIT_CYCLES = 2;
+const PERF_HIJACKED_CYCLES = 3;
+const PERF_SD_BUSY_CYCLES = 4;
+const PERF_CAS_BLOCKS = 5;
+const PERF_CAS_UNDERRUNS = 6;
+const PERF_UART_OVERRUNS = 7;
+
+const counterNames = [
+    "clock cycles",
+    "cpu cycles",
+    "ram wait cycles",
+    "hijacked cycles",
+    "sd busy cycles",
+    "cas blocks",
+    "cas underruns",
+    "uart overruns",
+];
+
+const clockHz = 80000000;
+
+// Read a snapshot of the counters
+async function readCounters(sc)
+{
+    await sc.write(`perf\n`);
+    let reply = await sc.readToEOL();
+    if (reply.startsWith("!"))
+        throw new Error(`perf failed: ${reply}`);
+    return reply.trim().split(" ").map(x => parseInt(x, 16));
+}
+
+function percent(value, total)
+{
+    return total ? `${(value * 100 / total).toFixed(1)}%` : "-";
+}
+
+// Format the differences between two snapshots
+function formatRates(prev, curr)
+{
+    // Counters are 32-bit and wrap
+    let d = curr.map((x, i) => (x - prev[i]) >>> 0);
+    let seconds = d[PERF_CLOCK_CYCLES] / clockHz;
+    let cpu = d[PERF_CPU_CYCLES] - d[PERF_RAM_WAIT_CYCLES];
+
+    return [
+        `cpu ${(cpu / seconds / 1000000).toFixed(3)}MHz`,
+        `ram wait ${percent(d[PERF_RAM_WAIT_CYCLES], d[PERF_CPU_CYCLES])}`,
+        `syscon ${percent(d[PERF_HIJACKED_CYCLES], d[PERF_CLOCK_CYCLES])}`,
+        `sd busy ${percent(d[PERF_SD_BUSY_CYCLES], d[PERF_CLOCK_CYCLES])}`,
+        `cas ${d[PERF_CAS_BLOCKS]} blocks ${d[PERF_CAS_UNDERRUNS]} late`,
+        `uart overruns ${d[PERF_UART_OVERRUNS]}`,
+    ].join("  ");
+}
+
+
+// Handle for `perf` command
+async function cmd_perf(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+            interval: 1000,
+            once: false,
+        }
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "interval":
+                        options.interval = Number(parts[1]);
+                        break;
+
+                    case "once":
+                        options.once = true;
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                throw new Error(`Unexpected arg: ${arg}`)
+            }
+        }
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        let prev = await readCounters(sc);
+
+        if (options.once)
+        {
+            for (let i=0; i<prev.length; i++)
+                console.log(`${(counterNames[i] || `counter ${i}`).padEnd(16)} ${prev[i]}`);
+            return;
+        }
+
+        while (true)
+        {
+            await new Promise(resolve => setTimeout(resolve, options.interval));
+            let curr = await readCounters(sc);
+            console.log(formatRates(prev, curr));
+            prev = curr;
+        }
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_perf;
@@ -1,6 +1,7 @@
 let SerialConversation = require('./serial-conversation');
 let fs = require('fs');
 let path = require('path');
+let crc32 = require('./crc32');
 
 function showHelp()
 {
@@ -11,6 +12,107 @@ function showHelp()
     console.log("Options:");
     console.log("  --port:<name>      serial port to connect to");
     console.log("  --baud:<value>     serial baud rate")
+    console.log("  --blocks           use the older block-by-block acknowledged transfer")
+}
+
+// Number of unacknowledged bytes allowed in flight during a streamed push.
+// The device acks every 512 bytes and its receive fifo is 2K.
+const streamWindow = 1024;
+
+
+
+// Push a file buffer to the device over an already open conversation
+async function pushFile(sc, fileBuf, targetName, options)
+{
+    if (!options || !options.blocks)
+        return await streamFile(sc, fileBuf, targetName);
+
+    // Send command and wait for ack
+    await sc.write(`push ${targetName} ${fileBuf.length}\n`);
+    await sc.waitAck();
+
+    // Log message
+    console.log(`Sending ${targetName} (${fileBuf.length} bytes) `)
+
+    // Send in chunks of 64 bytes
+    let pos = 0;
+    while (pos < fileBuf.length)
+    {
+        // Create chunk
+        let chunkLength = Math.min(fileBuf.length - pos, 64);
+        let chunkBuf = Buffer.alloc(chunkLength + 2);
+        fileBuf.copy(chunkBuf, 1, pos, pos+chunkLength);
+
+        // First byte is the chunk length
+        chunkBuf[0] = chunkLength;
+
+        // Last byte is the checksum
+        let checksum = 0;
+        for (let i=0; i<chunkLength; i++)
+        {
+            checksum += chunkBuf[i+1];
+        }
+        chunkBuf[chunkLength+1] = checksum & 0xFF;
+
+        // Send it, wait for ack
+        await sc.write(chunkBuf);
+        await sc.waitAck();
+
+        // Progress display
+        process.stdout.write(".");
+
+        // Update position
+        pos += chunkLength;
+    }
+
+    // Send the EOT and wait for ack
+    await sc.write("\x04");
+    await sc.waitAck();
+
+    process.stdout.write("\n");
+}
+
+// Stream a file to the device, keeping a bounded window of unacknowledged
+// data in flight rather than waiting for each block to be acknowledged
+async function streamFile(sc, fileBuf, targetName)
+{
+    // Send command and wait for ack
+    await sc.write(`spush ${targetName} ${fileBuf.length} ${crc32(fileBuf).toString(16)}\n`);
+    await sc.waitAck();
+
+    // Log message
+    console.log(`Sending ${targetName} (${fileBuf.length} bytes) `)
+
+    let pos = 0;
+    let acked = 0;
+    while (pos < fileBuf.length)
+    {
+        // Wait for window to open
+        while (pos - acked >= streamWindow)
+        {
+            await sc.waitAck();
+            acked += 512;
+            process.stdout.write(".");
+        }
+
+        // Send the next chunk
+        let chunkLength = Math.min(fileBuf.length - pos, acked + streamWindow - pos, 256);
+        await sc.write(fileBuf.slice(pos, pos + chunkLength));
+        pos += chunkLength;
+    }
+
+    // Collect the remaining window acks
+    while (acked + 512 <= fileBuf.length)
+    {
+        await sc.waitAck();
+        acked += 512;
+        process.stdout.write(".");
+    }
+
+    // Wait for final ack (crc checked and file renamed)
+    await sc.waitAck();
+
+    process.stdout.write("\n");
 }
 
 
@@ -42,6 +144,10 @@ async function cmd_push(args)
                         options.baud = Number(parts[1]);
                         break;
 
+                    case "blocks":
+                        options.blocks = true;
+                        break;
+
                     case "help":
                         showHelp();
                         return;
@@ -70,50 +176,11 @@ async function cmd_push(args)
         sc = new SerialConversation(options);
         await sc.open();
 
-        // Send command and wait for ack
-        await sc.write(`push ${targetName} ${fileBuf.length}\n`);
-        await sc.waitAck();
-
-        // Log message
-        console.log(`Sending ${targetName} (${fileBuf.length} bytes) `)
-
-        // Send in chunks of 64 bytes
-        let pos = 0;
-        while (pos < fileBuf.length)
-        {
-            // Create chunk
-            let chunkLength = Math.min(fileBuf.length - pos, 64);
-            let chunkBuf = Buffer.alloc(chunkLength + 2);
-            fileBuf.copy(chunkBuf, 1, pos, pos+chunkLength);
-
-            // First byte is the chunk length
-            chunkBuf[0] = chunkLength;
-
-            // Last byte is the checksum
-            let checksum = 0;
-            for (let i=0; i<chunkLength; i++)
-            {
-                checksum += chunkBuf[i+1];
-            }
-            chunkBuf[chunkLength+1] = checksum & 0xFF;
-
-            // Send it, wait for ack
-            await sc.write(chunkBuf);
-            await sc.waitAck();
-
-            // Progress display
-            process.stdout.write(".");
-
-            // Update position
-            pos += chunkLength;
-        }
-
-        // Send the EOT and wait for ack
-        await sc.write("\x04");
-        await sc.waitAck();
+        // Send it
+        await pushFile(sc, fileBuf, targetName, options);
 
         // Done!
-        console.log("\nOK");
+        console.log("OK");
     }
     finally
     {
@@ -124,3 +191,4 @@ async function cmd_push(args)
 }
 
 module.exports = cmd_push;
+module.exports.pushFile = pushFile;
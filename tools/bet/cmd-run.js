@@ -0,0 +1,184 @@
+let SerialConversation = require('./serial-conversation');
+let crc32 = require('./crc32');
+let tokenize = require('./basic-tokenizer');
+let fs = require('fs');
+
+function showHelp()
+{
+    console.log("Tokenizes a BASIC listing and loads it directly into TRS-80 memory");
+    console.log();
+    console.log("Usage: bet run [options] prog.bas");
+    console.log();
+    console.log("The TRS-80 should be at the Level II BASIC READY prompt.  The loaded");
+    console.log("program replaces the current program (like NEW followed by CLOAD).");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+    console.log("  --norun            load the program but don't RUN it")
+}
+
+// Number of unacknowledged bytes allowed in flight.  The device acks
+// every 512 bytes.
+const streamWindow = 1024;
+
+// Level II BASIC pointers
+const STKTOP = 0x40A0;          // Start of string space (the stack sits just below it)
+const TXTTAB = 0x40A4;          // Start of program
+const MEMSIZ = 0x40B1;          // Top of memory
+const VARTAB = 0x40F9;          // Start of simple variables (followed by ARYTAB and STREND)
+
+// Space to leave free below the string space for the stack (and a few
+// variables) so the program can actually RUN once loaded
+const stackMargin = 256;
+
+
+// Read a 16-bit word from TRS-80 memory
+async function peekWord(sc, addr)
+{
+    await sc.write(`peek ${addr.toString(16)} 2\n`);
+    let reply = await sc.readToEOL();
+    if (reply.startsWith("!"))
+        throw new Error(`peek failed: ${reply}`);
+    return parseInt(reply.substr(2, 2) + reply.substr(0, 2), 16);
+}
+
+// Write a buffer to TRS-80 memory
+async function poke(sc, addr, buf)
+{
+    await sc.write(`poke ${addr.toString(16)} ${buf.length} ${crc32(buf).toString(16)}\n`);
+    await sc.waitAck();
+
+    let pos = 0;
+    let acked = 0;
+    while (pos < buf.length)
+    {
+        // Wait for window to open
+        while (pos - acked >= streamWindow)
+        {
+            await sc.waitAck();
+            acked += 512;
+        }
+
+        // Send the next chunk
+        let chunkLength = Math.min(buf.length - pos, acked + streamWindow - pos, 256);
+        await sc.write(buf.slice(pos, pos + chunkLength));
+        pos += chunkLength;
+    }
+
+    // Collect the remaining window acks
+    while (acked + 512 <= buf.length)
+    {
+        await sc.waitAck();
+        acked += 512;
+    }
+
+    // Wait for final ack (crc checked)
+    await sc.waitAck();
+}
+
+
+// Handle for `run` command
+async function cmd_run(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+            run: true,
+        }
+        let files = [];
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "norun":
+                        options.run = false;
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                files.push(arg);
+            }
+        }
+
+        if (files.length != 1)
+            throw new Error("Expected a single file name");
+
+        let source = fs.readFileSync(files[0], "latin1");
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        // Find where the program goes (moved up by DOS)
+        let txttab = await peekWord(sc, TXTTAB);
+        let memsiz = await peekWord(sc, MEMSIZ);
+        let stktop = await peekWord(sc, STKTOP);
+        if (txttab < 0x4000 || txttab >= memsiz || stktop <= txttab || stktop > memsiz)
+            throw new Error(`BASIC doesn't appear to be initialized (program start ${txttab.toString(16)})`);
+
+        // Tokenize.  The program, its variables and the stack all have to
+        // fit below the string space reserved by CLEAR.
+        let program = tokenize(source, txttab);
+        let vartab = txttab + program.length;
+        let limit = stktop - stackMargin;
+        if (vartab >= limit)
+            throw new Error(`Program too large (${program.length} bytes, ${Math.max(limit - txttab, 0)} available)`);
+
+        console.log(`Loading ${files[0]} (${program.length} bytes at ${txttab.toString(16).toUpperCase()}h)`);
+
+        // Load the program, then point the variable and array tables
+        // and free memory at its end (as CLOAD does)
+        await poke(sc, txttab, program);
+
+        let ptrs = Buffer.alloc(6);
+        ptrs.writeUInt16LE(vartab, 0);
+        ptrs.writeUInt16LE(vartab, 2);
+        ptrs.writeUInt16LE(vartab, 4);
+        await poke(sc, VARTAB, ptrs);
+
+        // Run it
+        if (options.run)
+        {
+            let cmd = Buffer.from("RUN\n", "latin1");
+            await sc.write(`type ${cmd.length}\n`);
+            await sc.waitAck();
+            await sc.write(cmd);
+            await sc.waitAck();
+        }
+
+        console.log("OK");
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_run;
@@ -0,0 +1,229 @@
+let SerialConversation = require('./serial-conversation');
+
+function showHelp()
+{
+    console.log("Mirrors the TRS-80 screen and syscon overlay in the terminal");
+    console.log();
+    console.log("Usage: bet screen [options]");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+    console.log("  --interval:<ms>    poll interval (default 100)")
+    console.log("  --once             print the screen once and exit")
+}
+
+// Reply framing (see SCREEN_xxx in syscon.h)
+const SCREEN_MARKER = 0x1D;
+const SCREEN_END = 0xFF;
+const SCREEN_ROW_OVERLAY = 0x10;
+const SCREEN_FLAG_OVERLAY = 0x01;
+
+// Decode a row encoded by screen_rle() in uart_fiber.c
+function decodeRow(buf)
+{
+    let out = [];
+    let pos = 0;
+    while (pos < buf.length)
+    {
+        let count = buf[pos++];
+        if (count < 0x80)
+        {
+            for (let i=0; i<=count; i++)
+                out.push(buf[pos++]);
+        }
+        else
+        {
+            let value = buf[pos++];
+            for (let i=0; i<count - 0x80 + 3; i++)
+                out.push(value);
+        }
+    }
+    return out;
+}
+
+// Read one reply, updating the screen state.  Returns true if anything changed.
+async function readScreen(sc, state)
+{
+    // Skip anything that isn't a reply (eg: text messages)
+    while ((await sc.readWait(1))[0] != SCREEN_MARKER)
+        ;
+
+    let flags = (await sc.readWait(1))[0];
+    let overlay = !!(flags & SCREEN_FLAG_OVERLAY);
+    let changed = overlay != state.overlay;
+    state.overlay = overlay;
+
+    while (true)
+    {
+        let row = (await sc.readWait(1))[0];
+        if (row == SCREEN_END)
+            return changed;
+
+        let length = (await sc.readWait(1))[0];
+        let data = decodeRow(await sc.readWait(length));
+        if (row < SCREEN_ROW_OVERLAY)
+            state.trs80[row] = data;
+        else
+            state.syscon[row - SCREEN_ROW_OVERLAY] = data;
+        changed = true;
+    }
+}
+
+// Map a TRS-80 video byte to a character.  Bytes 0x80-0xFF are 2x3 block
+// graphics which map onto the Unicode sextant characters.
+function trs80Char(b)
+{
+    if (b < 0x20)
+        return String.fromCharCode(b + 0x40);
+    if (b < 0x80)
+        return String.fromCharCode(b);
+
+    let v = b & 0x3F;
+    switch (v)
+    {
+        case 0: return " ";
+        case 21: return "▌";
+        case 42: return "▐";
+        case 63: return "█";
+    }
+    return String.fromCodePoint(0x1FB00 + v - 1 - (v > 21 ? 1 : 0) - (v > 42 ? 1 : 0));
+}
+
+// Upper half of code page 437, used by the syscon's font for box drawing
+const cp437 =
+    "ÇüéâäàåçêëèïîìÄÅÉæÆôöòûùÿÖÜ¢£¥₧ƒáíóúñÑªº¿⌐¬½¼¡«»" +
+    "░▒▓│┤╡╢╖╕╣║╗╝╜╛┐└┴┬├─┼╞╟╚╔╩╦╠═╬╧╨╤╥╙╘╒╓╫╪┘┌█▄▌▐▀" +
+    "αßΓπΣσµτΦΘΩδ∞φε∩≡±≥≤⌠⌡÷≈°∙·√ⁿ²■ ";
+
+function sysconChar(b)
+{
+    if (b >= 0x80)
+        return cp437[b - 0x80];
+    if (b < 0x20)
+        return " ";
+    return String.fromCharCode(b);
+}
+
+// Format the current screen, with the overlay (when shown) below the TRS-80 screen
+function formatScreen(state)
+{
+    let lines = [];
+    let border = "+" + "-".repeat(64) + "+";
+    lines.push(border);
+    for (let row of state.trs80)
+        lines.push("|" + row.map(trs80Char).join("") + "|");
+    lines.push(border);
+
+    if (state.overlay)
+    {
+        let border = "+" + "-".repeat(32) + "+";
+        lines.push(border);
+        for (let row of state.syscon)
+            lines.push("|" + row.map(sysconChar).join("") + "|");
+        lines.push(border);
+    }
+
+    return lines;
+}
+
+
+// Handle for `screen` command
+async function cmd_screen(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+            interval: 100,
+            once: false,
+        }
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "interval":
+                        options.interval = Number(parts[1]);
+                        break;
+
+                    case "once":
+                        options.once = true;
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                throw new Error(`Unexpected arg: ${arg}`)
+            }
+        }
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        let state = {
+            trs80: new Array(16).fill(null).map(() => new Array(64).fill(0x20)),
+            syscon: new Array(16).fill(null).map(() => new Array(32).fill(0x20)),
+            overlay: false,
+        };
+
+        // Start with the whole screen
+        await sc.write(`screen full\n`);
+        await readScreen(sc, state);
+
+        if (options.once)
+        {
+            console.log(formatScreen(state).join("\n"));
+            return;
+        }
+
+        // Clear the terminal, then redraw from the top whenever anything changes
+        let lineCount = 0;
+        process.stdout.write("\x1b[2J");
+        while (true)
+        {
+            let lines = formatScreen(state);
+            let out = "\x1b[H" + lines.join("\x1b[K\n") + "\x1b[K\n";
+            if (lines.length < lineCount)
+                out += "\x1b[J";
+            lineCount = lines.length;
+            process.stdout.write(out);
+
+            do
+            {
+                await new Promise(resolve => setTimeout(resolve, options.interval));
+                await sc.write(`screen\n`);
+            } while (!await readScreen(sc, state));
+        }
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_screen;
@@ -0,0 +1,202 @@
+let SerialConversation = require('./serial-conversation');
+let pushFile = require('./cmd-push').pushFile;
+let crc32 = require('./crc32');
+let fs = require('fs');
+let path = require('path');
+
+function showHelp()
+{
+    console.log("Copies new and changed files in a local directory to the FPGA's SD card");
+    console.log();
+    console.log("Usage: bet sync [options] localDir [remoteDir]");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+    console.log("  --blocks           use the older block-by-block acknowledged transfer")
+    console.log("  --dry-run          list the files that would be sent, but don't send them")
+}
+
+// Maximum number of crc requests to have in flight at once.  The
+// device's receive buffer is small so keep this modest.
+const crcWindow = 4;
+
+
+// Read the remote directory listing, returns map of uppercase name => size
+async function listRemote(sc, remoteDir)
+{
+    await sc.write(`list ${remoteDir}\n`);
+
+    let map = new Map();
+    while (true)
+    {
+        let line = await sc.readToEOL();
+        if (line.length == 0)
+            break;
+        if (line[0] == '!')
+            throw new Error(`list failed - ${line.substr(1)}`);
+
+        let space = line.indexOf(' ');
+        map.set(line.substr(space + 1).toUpperCase(), Number(line.substr(0, space)));
+    }
+    return map;
+}
+
+
+// Handle for `sync` command
+async function cmd_sync(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+            dryRun: false,
+        }
+        let dirs = [];
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+        
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "blocks":
+                        options.blocks = true;
+                        break;
+
+                    case "dry-run":
+                        options.dryRun = true;
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+        
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                dirs.push(arg);
+            }
+        }
+
+        // Must have a directory to sync
+        if (dirs.length < 1)
+        {
+            throw new Error("No directory specified");
+        }
+
+        let localDir = dirs[0];
+        let remoteDir = dirs.length > 1 ? dirs[1] : "/";
+        if (!remoteDir.endsWith("/"))
+            remoteDir += "/";
+
+        // Get the local files (the device's command parser can't handle spaces)
+        let localFiles = [];
+        for (let name of fs.readdirSync(localDir))
+        {
+            let localPath = path.join(localDir, name);
+            if (!fs.statSync(localPath).isFile())
+                continue;
+
+            if (name.indexOf(' ') >= 0)
+            {
+                console.log(`Skipping ${name} (file names can't contain spaces)`);
+                continue;
+            }
+
+            localFiles.push({
+                name: name,
+                localPath: localPath,
+                remotePath: remoteDir + name,
+                size: fs.statSync(localPath).size,
+            });
+        }
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        // Get the remote directory listing
+        let remoteSizes = await listRemote(sc, remoteDir);
+
+        // Files that are missing or a different size definitely need sending,
+        // the rest need a crc check
+        let toSend = [];
+        let toCheck = [];
+        for (let f of localFiles)
+        {
+            let remoteSize = remoteSizes.get(f.name.toUpperCase());
+            if (remoteSize === undefined || remoteSize != f.size)
+                toSend.push(f);
+            else
+                toCheck.push(f);
+        }
+
+        // Pipeline the crc requests, keeping up to crcWindow in flight
+        let sent = 0;
+        let received = 0;
+        while (received < toCheck.length)
+        {
+            while (sent < toCheck.length && sent - received < crcWindow)
+            {
+                await sc.write(`crc ${toCheck[sent].remotePath}\n`);
+                sent++;
+            }
+
+            let f = toCheck[received++];
+            let line = await sc.readToEOL();
+            if (line[0] == '!')
+            {
+                toSend.push(f);
+                continue;
+            }
+
+            let parts = line.split(' ');
+            let remoteCrc = parseInt(parts[1], 16) >>> 0;
+            let localCrc = crc32(fs.readFileSync(f.localPath));
+            if (Number(parts[0]) != f.size || remoteCrc != localCrc)
+                toSend.push(f);
+        }
+
+        // Send changed files
+        let totalBytes = 0;
+        for (let f of toSend)
+        {
+            if (options.dryRun)
+            {
+                console.log(`Would send ${f.remotePath} (${f.size} bytes)`);
+                continue;
+            }
+
+            await pushFile(sc, fs.readFileSync(f.localPath), f.remotePath, options);
+            totalBytes += f.size;
+        }
+
+        // Done!
+        console.log(`${toSend.length} of ${localFiles.length} file(s) ${options.dryRun ? "need sending" : `sent, ${totalBytes} bytes`}`);
+        console.log("OK");
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_sync;
@@ -0,0 +1,122 @@
+let SerialConversation = require('./serial-conversation');
+let fs = require('fs');
+
+function showHelp()
+{
+    console.log("Types a text file on the TRS-80 keyboard (eg: to enter a BASIC listing)");
+    console.log();
+    console.log("Usage: bet type [options] file.txt");
+    console.log();
+    console.log("Options:");
+    console.log("  --port:<name>      serial port to connect to");
+    console.log("  --baud:<value>     serial baud rate")
+}
+
+// Number of untyped characters allowed in flight.  The device acks
+// every 64 characters typed.
+const typeWindow = 128;
+
+
+// Handle for `type` command
+async function cmd_type(args)
+{
+    let sc;
+    try
+    {
+        // Parse arguments
+        options = {
+            port: "COM8",
+            baud: 115200,
+        }
+        let files = [];
+
+        for (let arg of args.slice(1))
+        {
+            if (arg.startsWith("--"))
+            {
+                let parts = arg.substr(2).split(":");
+                switch (parts[0].toLowerCase())
+                {
+                    case "port":
+                        options.port = parts[1];
+                        break;
+        
+                    case "baud":
+                        options.baud = Number(parts[1]);
+                        break;
+
+                    case "help":
+                        showHelp();
+                        return;
+        
+                    default:
+                        throw new Error(`Unknown switch: ${parts[0]}`)
+                }
+            }
+            else
+            {
+                files.push(arg);
+            }
+        }
+
+        if (files.length != 1)
+            throw new Error("Expected a single file name");
+
+        // Read the text, normalize line endings and make sure the last line is entered
+        let text = fs.readFileSync(files[0], "latin1").replace(/\r\n?/g, "\n");
+        if (text.length > 0 && !text.endsWith("\n"))
+            text += "\n";
+        let buf = Buffer.from(text, "latin1");
+
+        // open serial port
+        sc = new SerialConversation(options);
+        await sc.open();
+
+        // Send command and wait for ack
+        await sc.write(`type ${buf.length}\n`);
+        await sc.waitAck();
+
+        console.log(`Typing ${files[0]} (${buf.length} characters) `)
+        let start = Date.now();
+
+        let pos = 0;
+        let acked = 0;
+        while (pos < buf.length)
+        {
+            // Wait for window to open
+            while (pos - acked >= typeWindow)
+            {
+                await sc.waitAck();
+                acked += 64;
+                process.stdout.write(".");
+            }
+
+            // Send the next chunk
+            let chunkLength = Math.min(buf.length - pos, acked + typeWindow - pos);
+            await sc.write(buf.slice(pos, pos + chunkLength));
+            pos += chunkLength;
+        }
+
+        // Collect the remaining window acks
+        while (acked + 64 <= buf.length)
+        {
+            await sc.waitAck();
+            acked += 64;
+            process.stdout.write(".");
+        }
+
+        // Wait for final ack
+        await sc.waitAck();
+
+        let seconds = (Date.now() - start) / 1000;
+        console.log(`\nOK (${seconds.toFixed(1)} seconds, ${(buf.length / seconds).toFixed(0)} characters/second)`);
+    }
+    finally
+    {
+        // Close connection
+        if (sc)
+            await sc.close();
+    }
+}
+
+module.exports = cmd_type;
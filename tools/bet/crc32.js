@@ -0,0 +1,33 @@
+// CRC-32 (IEEE 802.3) - must match syscon/crc32.c
+
+let table = null;
+
+function buildTable()
+{
+    table = new Uint32Array(256);
+    for (let n=0; n<256; n++)
+    {
+        let c = n;
+        for (let k=0; k<8; k++)
+        {
+            c = (c & 1) ? (0xEDB88320 ^ (c >>> 1)) : (c >>> 1);
+        }
+        table[n] = c >>> 0;
+    }
+}
+
+// Calculate the crc32 of a buffer, optionally continuing from a previous crc
+function crc32(buf, crc)
+{
+    if (!table)
+        buildTable();
+
+    crc = (crc || 0) ^ 0xFFFFFFFF;
+    for (let i=0; i<buf.length; i++)
+    {
+        crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >>> 8);
+    }
+    return (crc ^ 0xFFFFFFFF) >>> 0;
+}
+
+module.exports = crc32;
@@ -0,0 +1,17 @@
+// Trace event definitions (must match the TRACE_xxx ids in syscon/syscon.h)
+//
+// Each argument is either "name" (16-bit) or "name:32" (32-bit, sent as
+// two 16-bit words, low word first).  Add ":x" to show in hex.
+
+module.exports = {
+    0: { name: "end", args: [] },
+    1: { name: "dropped", args: [ "count" ] },
+    2: { name: "rom_loaded", args: [ "bytes" ] },
+    3: { name: "cas_block", args: [ "pos:32", "sector:32" ] },
+    4: { name: "spush", args: [ "received:32", "size:32" ] },
+    5: { name: "fdc_command", args: [ "cmd_drive:x", "track_sector:x" ] },
+    6: { name: "fdc_load", args: [ "drive", "track" ] },
+    7: { name: "cas_late", args: [ "pos:32", "count:32" ] },
+    8: { name: "fdc_read_error", args: [ "drive", "track" ] },
+    9: { name: "cas_saved", args: [ "result", "suffix" ] },
+};
@@ -1,6 +1,13 @@
 let glob = require('glob');
 let fs = require('fs');
 
+// caspack optimize [--leader:<n>] <input> [outdir]
+if (process.argv[2] == "optimize")
+{
+    require('./optimize')(process.argv.slice(3));
+    return;
+}
+
 let input = process.argv.length > 2 ? process.argv[2] : "*.cas";
 let output = process.argv.length > 3 ? process.argv[3] : "caspack.img";
 
@@ -0,0 +1,247 @@
+let glob = require('glob');
+let fs = require('fs');
+let path = require('path');
+
+// Shortest leader written.  The ROM only needs enough zero bits to find
+// the sync byte but the syscon's tape index (CAS_MIN_LEADER in
+// cassette_fiber.c) needs at least 32 zero bytes to recognize a program.
+const minLeader = 32;
+
+// 500 baud, each bit cell is 2ms regardless of value
+const secondsPerByte = 8 / 500;
+
+// Turbo tape runs the cassette at 40Mhz instead of 1.774Mhz
+const turboFactor = 1.774 / 40;
+
+// Parse a SYSTEM program following its 55h header byte, returns the
+// position after the entry address block
+function parseSystem(buf, pos, result)
+{
+    // Name
+    pos += 6;
+
+    while (pos < buf.length)
+    {
+        let blockType = buf[pos++];
+        if (blockType == 0x78)
+        {
+            // Entry address
+            if (pos + 2 > buf.length)
+                throw new Error("truncated entry address");
+            return pos + 2;
+        }
+
+        if (blockType != 0x3C)
+            throw new Error(`unknown block type ${blockType.toString(16)}h at ${pos - 1}`);
+
+        // Count (0 = 256), load address, data, checksum
+        if (pos + 3 > buf.length)
+            throw new Error("truncated block header");
+        let count = buf[pos] || 256;
+        let sum = buf[pos + 1] + buf[pos + 2];
+        pos += 3;
+        if (pos + count + 1 > buf.length)
+            throw new Error("truncated block");
+        for (let i=0; i<count; i++)
+            sum += buf[pos++];
+        if ((sum & 0xFF) != buf[pos])
+        {
+            let addr = buf[pos - count - 2] | (buf[pos - count - 1] << 8);
+            result.badChecksums.push(addr);
+        }
+        pos++;
+    }
+
+    throw new Error("missing entry address");
+}
+
+// Parse a BASIC program following its D3 D3 D3 header, returns the
+// position after the terminating null line link
+function parseBasic(buf, pos)
+{
+    // Name
+    pos += 1;
+
+    while (pos + 2 <= buf.length)
+    {
+        // Zero line link marks end of program
+        let link = buf[pos] | (buf[pos + 1] << 8);
+        pos += 2;
+        if (link == 0)
+            return pos;
+
+        // Line number and tokenized text
+        pos += 2;
+        while (pos < buf.length && buf[pos] != 0)
+            pos++;
+        pos++;
+    }
+
+    throw new Error("missing end of program");
+}
+
+// Split a tape into its programs, each without its leader and sync byte
+function parseTape(buf)
+{
+    let result = {
+        programs: [],
+        badChecksums: [],
+        syncDuplicates: 0,
+        discarded: 0,
+        error: null,
+    };
+
+    let pos = 0;
+    while (pos < buf.length)
+    {
+        // Leader
+        let start = pos;
+        while (pos < buf.length && buf[pos] == 0)
+            pos++;
+        if (pos == buf.length)
+        {
+            result.discarded += pos - start;
+            break;
+        }
+
+        // Sync byte, look for the next leader if it's not there
+        if (buf[pos] != 0xA5 || pos == start)
+        {
+            while (pos < buf.length && buf[pos] != 0)
+                pos++;
+            result.discarded += pos - start;
+            continue;
+        }
+        pos++;
+
+        // Skip duplicated sync bytes
+        while (pos < buf.length && buf[pos] == 0xA5)
+        {
+            result.syncDuplicates++;
+            pos++;
+        }
+
+        // Program
+        let programStart = pos;
+        try
+        {
+            if (buf[pos] == 0x55)
+                pos = parseSystem(buf, pos + 1, result);
+            else if (buf[pos] == 0xD3 && buf[pos + 1] == 0xD3 && buf[pos + 2] == 0xD3)
+                pos = parseBasic(buf, pos + 3);
+            else
+                throw new Error(`unknown program type ${(buf[pos] || 0).toString(16)}h at ${pos}`);
+        }
+        catch (err)
+        {
+            // Keep the rest of the tape as is
+            result.error = err.message;
+            result.tail = buf.slice(start);
+            break;
+        }
+
+        result.programs.push(buf.slice(programStart, pos));
+    }
+
+    return result;
+}
+
+// Rebuild a tape with minimum length leaders
+function buildTape(tape, leaderLength)
+{
+    let parts = [];
+    for (let p of tape.programs)
+    {
+        parts.push(Buffer.alloc(leaderLength));
+        parts.push(Buffer.from([0xA5]));
+        parts.push(p);
+    }
+    if (tape.tail)
+        parts.push(tape.tail);
+    return Buffer.concat(parts);
+}
+
+function formatSeconds(seconds)
+{
+    return `${seconds.toFixed(seconds < 10 ? 2 : 1)}s`;
+}
+
+// Handler for `caspack optimize [--leader:<n>] <input> [outdir]`
+function optimize(args)
+{
+    let leaderLength = minLeader;
+    let files = [];
+    for (let arg of args)
+    {
+        if (arg.startsWith("--"))
+        {
+            let parts = arg.substr(2).split(":");
+            switch (parts[0].toLowerCase())
+            {
+                case "leader":
+                    leaderLength = Number(parts[1]);
+                    if (!(leaderLength >= 1))
+                        throw new Error(`Bad leader length: ${parts[1]}`);
+                    if (leaderLength < minLeader)
+                        console.log(`Warning: programs with leaders shorter than ${minLeader} bytes won't be indexed by the syscon`);
+                    break;
+
+                default:
+                    throw new Error(`Unknown switch: ${parts[0]}`);
+            }
+        }
+        else
+        {
+            files.push(arg);
+        }
+    }
+
+    let input = files.length > 0 ? files[0] : "*.cas";
+    let outDir = files.length > 1 ? files[1] : null;
+
+    console.log("Optimizing:", input);
+    console.log("        to:", outDir || "(report only)");
+
+    // Buid a list of input files
+    let inFiles  = glob.hasMagic(input) ? glob.sync(input) : [input];
+
+    let totalSaved = 0;
+    for (let inFile of inFiles)
+    {
+        let buf = fs.readFileSync(inFile);
+        let tape = parseTape(buf);
+        let optimized = buildTape(tape, leaderLength);
+
+        // Never make a tape longer
+        if (optimized.length >= buf.length)
+            optimized = buf;
+
+        let saved = (buf.length - optimized.length) * secondsPerByte;
+        totalSaved += saved;
+
+        let notes = [];
+        if (tape.programs.length != 1)
+            notes.push(`${tape.programs.length} programs`);
+        if (tape.syncDuplicates)
+            notes.push(`${tape.syncDuplicates} extra sync`);
+        if (tape.discarded)
+            notes.push(`${tape.discarded} bytes discarded`);
+        if (tape.badChecksums.length)
+            notes.push(`bad checksum at ${tape.badChecksums.map(x => x.toString(16).toUpperCase() + "h").join(",")}`);
+        if (tape.error)
+            notes.push(`kept remainder (${tape.error})`);
+
+        console.log(`${inFile}: ${buf.length} -> ${optimized.length} bytes, saves ${formatSeconds(saved)} (turbo ${formatSeconds(saved * turboFactor)})${notes.length ? " - " + notes.join(", ") : ""}`);
+
+        if (outDir)
+        {
+            fs.mkdirSync(outDir, { recursive: true });
+            fs.writeFileSync(path.join(outDir, path.basename(inFile)), optimized);
+        }
+    }
+
+    if (inFiles.length > 1)
+        console.log(`Total saved: ${formatSeconds(totalSaved)} (turbo ${formatSeconds(totalSaved * turboFactor)})`);
+}
+
+module.exports = optimize;